@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "affinity.h"
+
+enum
+{
+    //the memory policy of mbind, the pages are taken from the other nodes, if the node is full
+    MPOL_PREFERRED_MODE = 1,
+
+    MAX_NODES = 1024
+};
+
+//the number in the file of the sysfs, -1 if there is no such file
+static int
+read_sys_int(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    int result;
+    if (fscanf(file, "%d", &result) != 1) {
+        result = -1;
+    }
+    fclose(file);
+    return result;
+}
+
+//the cpu directory has the link nodeN to its node
+static int
+cpu_node(int cpu)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit((unsigned char) entry->d_name[4])) {
+            result = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+//id of the cache of the highest level
+static int
+cpu_cache(int cpu)
+{
+    int result = -1;
+    int max_level = 0;
+    char path[PATH_MAX];
+    for (int index = 0; ; index++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+        int level = read_sys_int(path);
+        if (level < 0) {
+            break;
+        }
+        if (level > max_level) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/id", cpu, index);
+            max_level = level;
+            result = read_sys_int(path);
+        }
+    }
+    return result;
+}
+
+static int
+compare_places(const void *first, const void *second)
+{
+    const Cpu_place *a = first;
+    const Cpu_place *b = second;
+    int keys[][2] = {
+        {a->node, b->node},
+        {a->package, b->package},
+        {a->cache, b->cache},
+        {a->thread, b->thread},
+        {a->core, b->core},
+        {a->cpu, b->cpu}
+    };
+    for (unsigned i = 0; i < sizeof(keys) / sizeof(*keys); i++) {
+        if (keys[i][0] != keys[i][1]) {
+            return keys[i][0] < keys[i][1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+unsigned
+affinity_cpus(Cpu_place **places)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        *places = NULL;
+        return 0;
+    }
+
+    Cpu_place *result = calloc(CPU_COUNT(&allowed), sizeof(*result));
+    unsigned count = 0;
+    char path[PATH_MAX];
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        Cpu_place *place = &result[count];
+        place->cpu = cpu;
+        place->node = cpu_node(cpu);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        place->package = read_sys_int(path);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        place->core = read_sys_int(path);
+        place->cache = cpu_cache(cpu);
+
+        //the siblings of the core are found in the increasing order of the cpus
+        place->thread = 0;
+        for (unsigned k = 0; k < count; k++) {
+            if (result[k].package == place->package && result[k].core == place->core) {
+                place->thread += 1;
+            }
+        }
+        count += 1;
+    }
+
+    qsort(result, count, sizeof(*result), compare_places);
+    *places = result;
+    return count;
+}
+
+bool
+affinity_pin(const Cpu_place *places, unsigned count, unsigned num, bool whole_node)
+{
+    if (num >= count) {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned k = 0; k < count; k++) {
+        if (k == num || (whole_node && places[k].node == places[num].node)) {
+            CPU_SET(places[k].cpu, &set);
+        }
+    }
+    //zero is the calling thread, not the whole process
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool
+affinity_bind_memory(void *address, size_t size, size_t page_size, int node)
+{
+    if (node < 0 || node >= MAX_NODES) {
+        return false;
+    }
+
+    unsigned long mask[MAX_NODES / (sizeof(unsigned long) * CHAR_BIT)];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (sizeof(unsigned long) * CHAR_BIT)] = 1UL << (node % (sizeof(unsigned long) * CHAR_BIT));
+
+    uintptr_t start = (uintptr_t) address / page_size * page_size;
+    uintptr_t end = ((uintptr_t) address + size + page_size - 1) / page_size * page_size;
+
+    //the kernel counts one bit less, than the maximal node
+    return syscall(
+        SYS_mbind,
+        start,
+        end - start,
+        MPOL_PREFERRED_MODE,
+        mask,
+        MAX_NODES + 1,
+        0) == 0;
+}
@@ -0,0 +1,33 @@
+#ifndef AFFINITY_H_INCLUDED
+#define AFFINITY_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//place of the processor in the topology of the machine, read from /sys/devices/system/cpu
+typedef struct Cpu_place
+{
+    int cpu;
+    int node; //numa node, 0 if it's unknown
+    int package; //socket
+    int cache; //id of the last level cache, -1 if it's unknown
+    int core;
+    int thread; //number of the hardware thread in the core
+} Cpu_place;
+
+//the processors, allowed to the process, in the order of the topology: by the node, the socket,
+//the last level cache, then the first threads of all of the cores before the second ones,
+//so the neighbours in the order share the caches and the memory, but not the cores
+//returns the count, the array is freed by the caller
+unsigned affinity_cpus(Cpu_place **);
+
+//pins the calling thread (or process) to the processor of the place, or to all of the
+//processors of its node from the array
+bool affinity_pin(const Cpu_place *places, unsigned count, unsigned num, bool whole_node);
+
+//the pages of the range are allocated on the node, whoever touches them first
+//(the range is extended to the whole pages of the mapping, which can be the huge ones:
+//the kernel rejects the parts of them, fails without the numa support in the kernel)
+bool affinity_bind_memory(void *, size_t, size_t page_size, int node);
+
+#endif //AFFINITY_H_INCLUDED
@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "barrier.h"
+
+enum
+{
+    //iterations of spinning before going to sleep
+    BARRIER_SPIN_COUNT = 1024
+};
+
+static inline void
+cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+//the futex is used by the different processes, so it can't be private
+static inline void
+futex_wait(atomic_uint *address, unsigned value)
+{
+    syscall(SYS_futex, address, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static inline void
+futex_wake_all(atomic_uint *address)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+unsigned
+barrier_spin_count(unsigned participants)
+{
+    //spinning participant takes the processor from the one it's waiting for
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors >= (long) participants ? BARRIER_SPIN_COUNT : 0;
+}
+
+void
+barrier_init(Barrier *barrier, unsigned participants)
+{
+    atomic_init(&barrier->remaining, participants);
+    atomic_init(&barrier->sense, 0);
+    atomic_init(&barrier->sleepers, 0);
+    barrier->participants = participants;
+    barrier->spin_count = barrier_spin_count(participants);
+}
+
+void
+barrier_wait(Barrier *barrier, unsigned *local_sense)
+{
+    unsigned sense = *local_sense ^ 1;
+    *local_sense = sense;
+
+    if (atomic_fetch_sub_explicit(&barrier->remaining, 1, memory_order_acq_rel) == 1) {
+        //the last one: prepare the barrier for the next use and release the others
+        atomic_store_explicit(&barrier->remaining, barrier->participants, memory_order_relaxed);
+        atomic_store(&barrier->sense, sense);
+        if (atomic_load(&barrier->sleepers) != 0) {
+            futex_wake_all(&barrier->sense);
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < barrier->spin_count; i++) {
+        if (atomic_load_explicit(&barrier->sense, memory_order_acquire) == sense) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    //the sense is checked after the registration, so the wake up can't be missed:
+    //either the last participant sees us, or futex_wait sees the new sense
+    atomic_fetch_add(&barrier->sleepers, 1);
+    while (atomic_load(&barrier->sense) != sense) {
+        futex_wait(&barrier->sense, sense ^ 1);
+    }
+    atomic_fetch_sub(&barrier->sleepers, 1);
+}
+
+void
+progress_init(Progress *progress)
+{
+    atomic_init(&progress->value, 0);
+    atomic_init(&progress->sleepers, 0);
+}
+
+void
+progress_publish(Progress *progress, unsigned value)
+{
+    atomic_store(&progress->value, value);
+    if (atomic_load(&progress->sleepers) != 0) {
+        futex_wake_all(&progress->value);
+    }
+}
+
+static inline bool
+progress_reached(unsigned value, unsigned target)
+{
+    return (int) (value - target) >= 0;
+}
+
+bool
+progress_check(Progress *progress, unsigned target)
+{
+    return progress_reached(atomic_load_explicit(&progress->value, memory_order_acquire), target);
+}
+
+void
+progress_wait(Progress *progress, unsigned target, unsigned spin_count)
+{
+    for (unsigned i = 0; i < spin_count; i++) {
+        if (progress_reached(atomic_load_explicit(&progress->value, memory_order_acquire), target)) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    //the same order, as in barrier_wait: register, then check the value
+    atomic_fetch_add(&progress->sleepers, 1);
+    unsigned value;
+    while (!progress_reached(value = atomic_load(&progress->value), target)) {
+        futex_wait(&progress->value, value);
+    }
+    atomic_fetch_sub(&progress->sleepers, 1);
+}
@@ -0,0 +1,40 @@
+#ifndef BARRIER_H_INCLUDED
+#define BARRIER_H_INCLUDED
+
+#include <stdatomic.h>
+
+//sense-reversing barrier, which can be placed in the shared memory
+//and used by the processes or threads
+//waiting participants spin for a while, then sleep on the futex
+typedef struct Barrier
+{
+    atomic_uint remaining; //participants, which haven't arrived yet
+    atomic_uint sense; //flipped by the last participant (futex word)
+    atomic_uint sleepers; //participants, sleeping on the futex
+
+    unsigned participants;
+    unsigned spin_count; //zero, if there are more participants than processors
+} Barrier;
+
+//counter of the generations, published by one participant, which the others can wait for
+//(it wraps around, the waited values must be less than 2^31 ahead)
+typedef struct Progress
+{
+    atomic_uint value; //futex word
+    atomic_uint sleepers;
+} Progress;
+
+//spin iterations for the given number of the waiting participants
+unsigned barrier_spin_count(unsigned);
+
+void barrier_init(Barrier *, unsigned);
+
+//local_sense is owned by the participant and must be zero before the first wait
+void barrier_wait(Barrier *, unsigned *local_sense);
+
+void progress_init(Progress *);
+void progress_publish(Progress *, unsigned);
+void progress_wait(Progress *, unsigned, unsigned spin_count); //until the value is reached
+bool progress_check(Progress *, unsigned); //the value is reached already
+
+#endif //BARRIER_H_INCLUDED
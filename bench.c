@@ -0,0 +1,708 @@
+#define _GNU_SOURCE
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "board.h"
+
+enum
+{
+    DEFAULT_MAX_WORKERS = 16,
+    DEFAULT_INSTRUCTIONS = 10000,
+    WARMUP_INSTRUCTIONS = 100,
+
+    //chunks are tiny, so the calculation doesn't hide the synchronization
+    BENCH_CHUNK_SIZE = 8,
+
+    DEFAULT_STARTUP_WORKERS = 1024,
+    DEFAULT_STARTUP_REPEATS = 3,
+
+    DEFAULT_HALO_WORKERS = 8,
+    DEFAULT_GENERATIONS = 2000,
+    HALO_CHUNK_SIZE = 32,
+    MAX_HALO_DEPTH = 16,
+
+    //the schedule is checked on the grid of the chunks of at least 3x3
+    DEFAULT_SCHEDULE_WORKERS = 9,
+    SCHEDULE_SHAPES = 2,
+    SCHEDULE_SEEDS = 3,
+
+    //the part of every worker is a square of this size, the soup is only in the first one
+    STEAL_PART_SIZE = 128,
+    MAX_CHUNKS_PER_WORKER = 16,
+    MAX_REBALANCE_INTERVAL = 256,
+    MAX_HISTORY_MIB = 64
+};
+
+static const char *USAGE_INFO =
+    "Correct use:\n"
+    "./life-bench dispatch [max_workers] [instructions]\n"
+    "  latency of one instruction for 1..max_workers workers with every backend and synchronization\n"
+    "./life-bench startup [max_workers] [repeats]\n"
+    "  time of board_create, the first instruction and board_destroy for 1, 2, 4, ..., max_workers\n"
+    "./life-bench halo [workers] [generations]\n"
+    "  time of board_run on small chunks with the different depths of the borders\n"
+    "./life-bench schedule [workers] [generations]\n"
+    "  compares board_run (neighbour synchronization) and the lockstep board_next_turn\n"
+    "  with the reference on the grid of the chunks for several soups, sizes and depths of the halo\n"
+    "./life-bench steal [workers] [generations]\n"
+    "  time of board_run on the square board with the soup in the corner for 1, 2, 4, ..., 16\n"
+    "  chunks per worker, which the idle workers steal, the busy time of the busiest worker\n"
+    "  and the idle time of all of them\n"
+    "./life-bench rebalance [workers] [generations]\n"
+    "  the same with one chunk per worker, which are rebalanced by the density of the cells\n"
+    "  once in 1, 4, 16, ..., 256 generations or never\n"
+    "./life-bench affinity [workers] [generations]\n"
+    "  time of board_run on the soup with the workers pinned to the processors or the nodes\n"
+    "./life-bench history [workers] [generations]\n"
+    "  time of board_run with the history of 0, 1, 4, ..., 64 MiB, its depth and the time of the undo,\n"
+    "  checks the undo after the periods, skipped by board_fast_forward";
+
+static double
+now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+typedef struct Bench_config
+{
+    const char *name;
+    Board_backend backend;
+    Board_sync sync;
+} Bench_config;
+
+static const Bench_config configs[] = {
+    {"proc/semaphores", BOARD_BACKEND_PROCESSES, BOARD_SYNC_SEMAPHORES},
+    {"proc/futex", BOARD_BACKEND_PROCESSES, BOARD_SYNC_FUTEX},
+    {"threads/futex", BOARD_BACKEND_THREADS, BOARD_SYNC_FUTEX}
+};
+
+enum
+{
+    CONFIGS_COUNT = sizeof(configs) / sizeof(*configs)
+};
+
+static bool
+bench_dispatch(unsigned max_workers, unsigned instructions)
+{
+    printf("%8s", "workers");
+    for (unsigned k = 0; k < CONFIGS_COUNT; k++) {
+        printf(" %16s", configs[k].name);
+    }
+    printf("   (microseconds per instruction)\n");
+
+    Board_options options;
+    board_options_init(&options);
+    for (unsigned workers = 1; workers <= max_workers; workers++) {
+        printf("%8u", workers);
+        for (unsigned k = 0; k < CONFIGS_COUNT; k++) {
+            options.backend = configs[k].backend;
+            options.sync = configs[k].sync;
+            Board *board = board_create(workers * BENCH_CHUNK_SIZE, BENCH_CHUNK_SIZE, workers, &options);
+            if (board == NULL) {
+                printf(" %16s", "-");
+                continue;
+            }
+
+            for (unsigned i = 0; i < WARMUP_INSTRUCTIONS; i++) {
+                board_next_turn(board);
+            }
+            double start = now();
+            for (unsigned i = 0; i < instructions; i++) {
+                board_next_turn(board);
+            }
+            double elapsed = now() - start;
+
+            board_destroy(board);
+            printf(" %16.2f", elapsed / instructions * 1e6);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return true;
+}
+
+//the workers are started by board_create, but the time until all of them are ready
+//is seen only at the first instruction, so it's measured separately
+static bool
+bench_startup(unsigned max_workers, unsigned repeats)
+{
+    printf("%8s", "workers");
+    for (unsigned k = 0; k < CONFIGS_COUNT; k++) {
+        printf(" %16s", configs[k].name);
+    }
+    printf("   (milliseconds of create + first instruction + destroy, best of %u)\n", repeats);
+
+    Board_options options;
+    board_options_init(&options);
+    for (unsigned workers = 1; workers <= max_workers; workers *= 2) {
+        printf("%8u", workers);
+        for (unsigned k = 0; k < CONFIGS_COUNT; k++) {
+            options.backend = configs[k].backend;
+            options.sync = configs[k].sync;
+
+            double create_time = 0;
+            double first_time = 0;
+            double destroy_time = 0;
+            bool failed = false;
+            for (unsigned r = 0; r < repeats && !failed; r++) {
+                double start = now();
+                Board *board = board_create(workers * BENCH_CHUNK_SIZE, BENCH_CHUNK_SIZE, workers, &options);
+                double created = now();
+                if (board == NULL) {
+                    failed = true;
+                    continue;
+                }
+                board_next_turn(board);
+                double first = now();
+                board_destroy(board);
+                double destroyed = now();
+
+                if (r == 0 || created - start + first - created + destroyed - first <
+                    create_time + first_time + destroy_time) {
+                    create_time = created - start;
+                    first_time = first - created;
+                    destroy_time = destroyed - first;
+                }
+            }
+
+            if (failed) {
+                printf(" %16s", "-");
+            } else {
+                char times[32];
+                snprintf(times, sizeof(times), "%.1f+%.1f+%.1f",
+                    create_time * 1e3, first_time * 1e3, destroy_time * 1e3);
+                printf(" %16s", times);
+            }
+        }
+        printf("\n");
+    }
+    return true;
+}
+
+//random soup, so every chunk is calculated
+static void
+fill_random(Board *board)
+{
+    char *line = calloc(board->width + 1, sizeof(*line));
+    for (unsigned j = 1; j <= board->height; j++) {
+        for (unsigned i = 0; i < board->width; i++) {
+            line[i] = rand() % 3 == 0 ? '*' : '.';
+        }
+        board_set_scanline(board, j, line);
+    }
+    free(line);
+}
+
+static bool
+bench_halo(unsigned workers, unsigned generations)
+{
+    printf("%8s %16s   (microseconds per generation, %u workers)\n", "depth", "run", workers);
+
+    Board_options options;
+    board_options_init(&options);
+    for (unsigned depth = 1; depth <= MAX_HALO_DEPTH; depth *= 2) {
+        options.halo_depth = depth;
+        Board *board = board_create(workers * HALO_CHUNK_SIZE, HALO_CHUNK_SIZE, workers, &options);
+        if (board == NULL) {
+            printf("%8u %16s\n", depth, "-");
+            continue;
+        }
+
+        srand(1);
+        fill_random(board);
+        board_run(board, WARMUP_INSTRUCTIONS);
+        double start = now();
+        board_run(board, generations);
+        double elapsed = now() - start;
+
+        board_destroy(board);
+        printf("%8u %16.2f\n", depth, elapsed / generations * 1e6);
+    }
+    return true;
+}
+
+static bool
+boards_equal(Board *first, Board *second)
+{
+    bool result = true;
+    for (unsigned j = 1; j <= first->height && result; j++) {
+        char *first_line = board_get_scanline(first, j);
+        char *second_line = board_get_scanline(second, j);
+        result = strcmp(first_line, second_line) == 0;
+        free(first_line);
+        free(second_line);
+    }
+    return result;
+}
+
+//the soup as the scanlines of the board, one after another
+static char *
+random_soup(unsigned width, unsigned height)
+{
+    char *result = calloc((size_t) width * height, sizeof(*result));
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        result[i] = rand() % 3 == 0 ? '*' : '.';
+    }
+    return result;
+}
+
+static void
+load_soup(Board *board, const char *soup)
+{
+    char *line = calloc(board->width + 1, sizeof(*line));
+    for (unsigned j = 1; j <= board->height; j++) {
+        memcpy(line, soup + (size_t) (j - 1) * board->width, board->width);
+        board_set_scanline(board, j, line);
+    }
+    free(line);
+}
+
+static bool
+board_equals_soup(Board *board, const char *soup)
+{
+    bool result = true;
+    for (unsigned j = 1; j <= board->height && result; j++) {
+        char *line = board_get_scanline(board, j);
+        result = memcmp(line, soup + (size_t) (j - 1) * board->width, board->width) == 0;
+        free(line);
+    }
+    return result;
+}
+
+//the reference, which doesn't share any code with the board: the plain rules
+//on the array of the scanlines, the cells outside of the board are dead
+static void
+reference_run(char *soup, unsigned width, unsigned height, unsigned generations)
+{
+    char *next = calloc((size_t) width * height, sizeof(*next));
+    for (unsigned g = 0; g < generations; g++) {
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                unsigned neighbours = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = (int) x + dx;
+                        int ny = (int) y + dy;
+                        if ((dx != 0 || dy != 0) && nx >= 0 && ny >= 0 && nx < (int) width && ny < (int) height &&
+                            soup[(size_t) ny * width + nx] == '*') {
+                            neighbours += 1;
+                        }
+                    }
+                }
+                bool alive = soup[(size_t) y * width + x] == '*';
+                next[(size_t) y * width + x] = neighbours == 3 || (alive && neighbours == 2) ? '*' : '.';
+            }
+        }
+        memcpy(soup, next, (size_t) width * height);
+    }
+    free(next);
+}
+
+//the soups are calculated by the global barrier on every generation and by board_run,
+//where the chunks wait only for their neighbours, on the grid of the chunks of the workers
+//(of the even and the uneven sizes) with several depths of the halo, and compared
+//with the reference, so every chunk waits for the neighbours on all of its sides and corners
+static bool
+bench_schedule(unsigned workers, unsigned generations)
+{
+    static const unsigned depths[] = {1, 3, 8};
+
+    //the side of the grid of the workers, which is as square as possible
+    unsigned side = 1;
+    while (side * side < workers) {
+        side += 1;
+    }
+    const unsigned sizes[SCHEDULE_SHAPES][2] = {
+        {side * HALO_CHUNK_SIZE, side * HALO_CHUNK_SIZE},
+        {side * HALO_CHUNK_SIZE + 7, side * HALO_CHUNK_SIZE - 13}
+    };
+
+    //the reference results of every shape and seed
+    char *soups[SCHEDULE_SHAPES][SCHEDULE_SEEDS];
+    char *results[SCHEDULE_SHAPES][SCHEDULE_SEEDS];
+    for (unsigned shape = 0; shape < SCHEDULE_SHAPES; shape++) {
+        for (unsigned seed = 0; seed < SCHEDULE_SEEDS; seed++) {
+            unsigned width = sizes[shape][0];
+            unsigned height = sizes[shape][1];
+            srand(seed + 1);
+            soups[shape][seed] = random_soup(width, height);
+            results[shape][seed] = malloc((size_t) width * height);
+            memcpy(results[shape][seed], soups[shape][seed], (size_t) width * height);
+            reference_run(results[shape][seed], width, height, generations);
+        }
+    }
+
+    printf("%16s %8s %16s %16s %10s   (microseconds per generation, %u workers, %u seeds, %ux%u and %ux%u)\n",
+        "config", "depth", "lockstep", "run", "result", workers, SCHEDULE_SEEDS,
+        sizes[0][0], sizes[0][1], sizes[1][0], sizes[1][1]);
+
+    bool result = true;
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    for (unsigned k = 0; k < CONFIGS_COUNT; k++) {
+        options.backend = configs[k].backend;
+        options.sync = configs[k].sync;
+        for (unsigned d = 0; d < sizeof(depths) / sizeof(*depths); d++) {
+            options.halo_depth = depths[d];
+
+            double lockstep_time = 0;
+            double run_time = 0;
+            bool equal = true;
+            bool failed = false;
+            for (unsigned shape = 0; shape < SCHEDULE_SHAPES && !failed; shape++) {
+                for (unsigned seed = 0; seed < SCHEDULE_SEEDS && !failed; seed++) {
+                    Board *lockstep = board_create(sizes[shape][0], sizes[shape][1], workers, &options);
+                    Board *run = board_create(sizes[shape][0], sizes[shape][1], workers, &options);
+                    if (lockstep == NULL || run == NULL) {
+                        failed = true;
+                        if (lockstep != NULL) {
+                            board_destroy(lockstep);
+                        }
+                        if (run != NULL) {
+                            board_destroy(run);
+                        }
+                        continue;
+                    }
+                    load_soup(lockstep, soups[shape][seed]);
+                    load_soup(run, soups[shape][seed]);
+
+                    double start = now();
+                    for (unsigned i = 0; i < generations; i++) {
+                        board_next_turn(lockstep);
+                    }
+                    lockstep_time += now() - start;
+
+                    start = now();
+                    board_run(run, generations);
+                    run_time += now() - start;
+
+                    equal = equal &&
+                        board_equals_soup(lockstep, results[shape][seed]) &&
+                        board_equals_soup(run, results[shape][seed]);
+
+                    board_destroy(lockstep);
+                    board_destroy(run);
+                }
+            }
+
+            if (failed) {
+                printf("%16s %8u %16s\n", configs[k].name, depths[d], "-");
+                continue;
+            }
+            result = result && equal;
+            unsigned count = SCHEDULE_SHAPES * SCHEDULE_SEEDS * generations;
+            printf("%16s %8u %16.2f %16.2f %10s\n",
+                configs[k].name,
+                depths[d],
+                lockstep_time / count * 1e6,
+                run_time / count * 1e6,
+                equal ? "identical" : "DIFFERENT");
+        }
+    }
+
+    for (unsigned shape = 0; shape < SCHEDULE_SHAPES; shape++) {
+        for (unsigned seed = 0; seed < SCHEDULE_SEEDS; seed++) {
+            free(soups[shape][seed]);
+            free(results[shape][seed]);
+        }
+    }
+    return result;
+}
+
+//the soup in the first part of the strip of the parts of the workers
+static void
+fill_first_part(Board *board)
+{
+    char *line = calloc(board->width + 1, sizeof(*line));
+    memset(line, '.', board->width);
+    for (unsigned j = 1; j <= board->height; j++) {
+        for (unsigned i = 0; i < STEAL_PART_SIZE; i++) {
+            line[i] = rand() % 3 == 0 ? '*' : '.';
+        }
+        board_set_scanline(board, j, line);
+    }
+    free(line);
+}
+
+//the soup in the corner of the square board of the parts of the workers
+static void
+fill_corner(Board *board)
+{
+    char *line = calloc(board->width + 1, sizeof(*line));
+    memset(line, '.', board->width);
+    for (unsigned j = 1; j <= STEAL_PART_SIZE; j++) {
+        for (unsigned i = 0; i < STEAL_PART_SIZE; i++) {
+            line[i] = rand() % 3 == 0 ? '*' : '.';
+        }
+        board_set_scanline(board, j, line);
+    }
+    free(line);
+}
+
+//the dense corner makes the work of the workers uneven: without the stealing the busiest one
+//calculates most of the time, while the others wait, the time of the run is split by the workers
+//into the busy time (on the chunks) and the idle one (the waits for the others, the barriers)
+static bool
+bench_steal(unsigned workers, unsigned generations)
+{
+    printf("%8s %16s %16s %16s %16s   (%u workers, the share of the time of the run)\n",
+        "chunks", "run", "busiest worker", "idle", "stolen", workers);
+
+    //the side of the square of the parts of the workers
+    unsigned side = 1;
+    while (side * side < workers) {
+        side += 1;
+    }
+
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    for (unsigned chunks = 1; chunks <= MAX_CHUNKS_PER_WORKER; chunks *= 2) {
+        options.chunks_per_worker = chunks;
+        Board *board = board_create(side * STEAL_PART_SIZE, side * STEAL_PART_SIZE, workers, &options);
+        if (board == NULL) {
+            printf("%8u %16s\n", chunks, "-");
+            continue;
+        }
+
+        srand(1);
+        fill_corner(board);
+        double start = now();
+        board_run(board, generations);
+        double elapsed = now() - start;
+
+        //the busy time of the busiest worker, the idle one of all of them and the stolen chunk-generations
+        unsigned long long total_turns = 0;
+        unsigned long long stolen = 0;
+        double busiest = 0;
+        double idle = 0;
+        for (unsigned k = 0; k < workers; k++) {
+            unsigned long long chunk_turns;
+            unsigned long long stolen_turns;
+            unsigned long long busy_ns;
+            unsigned long long wait_ns;
+            board_get_worker_turns(board, k, &chunk_turns, &stolen_turns);
+            board_get_worker_times(board, k, &busy_ns, &wait_ns);
+            total_turns += chunk_turns;
+            stolen += stolen_turns;
+            double busy = busy_ns * 1e-9;
+            if (busy > busiest) {
+                busiest = busy;
+            }
+            idle += elapsed > busy ? elapsed - busy : 0;
+        }
+        board_destroy(board);
+
+        char busiest_share[32];
+        char idle_share[32];
+        char stolen_share[32];
+        snprintf(busiest_share, sizeof(busiest_share), "%.1f%%", 100.0 * busiest / elapsed);
+        snprintf(idle_share, sizeof(idle_share), "%.1f%%", 100.0 * idle / (elapsed * workers));
+        snprintf(stolen_share, sizeof(stolen_share), "%.1f%%", total_turns == 0 ? 0 : 100.0 * stolen / total_turns);
+        printf("%8u %14.2fus %16s %16s %16s\n",
+            chunks, elapsed / generations * 1e6, busiest_share, idle_share, stolen_share);
+    }
+    return true;
+}
+
+static bool
+bench_rebalance(unsigned workers, unsigned generations)
+{
+    printf("%10s %16s %16s   (%u workers)\n", "interval", "run", "rebalances", workers);
+
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    for (unsigned interval = 1; interval <= MAX_REBALANCE_INTERVAL * 4; interval *= 4) {
+        //the last one is without the rebalancing
+        options.rebalance_interval = interval <= MAX_REBALANCE_INTERVAL ? interval : 0;
+        Board *board = board_create(workers * STEAL_PART_SIZE, STEAL_PART_SIZE, workers, &options);
+        if (board == NULL) {
+            printf("%10u %16s\n", interval, "-");
+            continue;
+        }
+
+        srand(1);
+        fill_first_part(board);
+        double start = now();
+        board_run(board, generations);
+        double elapsed = now() - start;
+
+        char name[32] = "never";
+        if (options.rebalance_interval != 0) {
+            snprintf(name, sizeof(name), "%u", interval);
+        }
+        printf("%10s %14.2fus %16llu\n", name, elapsed / generations * 1e6, board->rebalances_count);
+        board_destroy(board);
+    }
+    return true;
+}
+
+static bool
+bench_affinity(unsigned workers, unsigned generations)
+{
+    static const struct
+    {
+        const char *name;
+        Board_affinity affinity;
+    } policies[] = {
+        {"none", BOARD_AFFINITY_NONE},
+        {"cores", BOARD_AFFINITY_CORES},
+        {"nodes", BOARD_AFFINITY_NODES}
+    };
+
+    printf("%8s %16s   (microseconds per generation, %u workers)\n", "affinity", "run", workers);
+
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    for (unsigned i = 0; i < sizeof(policies) / sizeof(*policies); i++) {
+        options.affinity = policies[i].affinity;
+        Board *board = board_create(workers * STEAL_PART_SIZE, STEAL_PART_SIZE, workers, &options);
+        if (board == NULL) {
+            printf("%8s %16s\n", policies[i].name, "-");
+            continue;
+        }
+
+        srand(1);
+        fill_random(board);
+        board_run(board, WARMUP_INSTRUCTIONS);
+        double start = now();
+        board_run(board, generations);
+        double elapsed = now() - start;
+
+        board_destroy(board);
+        printf("%8s %16.2f\n", policies[i].name, elapsed / generations * 1e6);
+    }
+    return true;
+}
+
+//the blinker and the lone cell, which dies in the first turn: the undo can't cross the periods,
+//skipped by board_fast_forward, and returns to the generations after them
+static bool
+check_history_skip(void)
+{
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    options.history_budget = 1 << 20;
+    Board *board = board_create(HALO_CHUNK_SIZE, HALO_CHUNK_SIZE, 2, &options);
+    Board *copy = board_create(HALO_CHUNK_SIZE, HALO_CHUNK_SIZE, 2, &options);
+    if (board == NULL || copy == NULL) {
+        return false;
+    }
+
+    board_add_cell(board, 5, 4);
+    board_add_cell(board, 5, 5);
+    board_add_cell(board, 5, 6);
+    board_add_cell(board, 20, 20);
+    board_run(board, 3);
+    board_fast_forward(board, 1000);
+    bool result = !board_undo(board, 3);
+
+    board_import(copy, board_export(board));
+    board_run(board, 3);
+    result = result && board_undo(board, 3) && boards_equal(board, copy);
+
+    board_destroy(board);
+    board_destroy(copy);
+    return result;
+}
+
+static bool
+bench_history(unsigned workers, unsigned generations)
+{
+    printf("%8s %16s %16s %16s   (microseconds per generation, %u workers)\n",
+        "MiB", "run", "depth", "undo", workers);
+
+    Board_options options;
+    board_options_init(&options);
+    options.partition = BOARD_PARTITION_GRID;
+    for (unsigned budget = 0; budget <= MAX_HISTORY_MIB; budget = budget == 0 ? 1 : budget * 4) {
+        options.history_budget = (size_t) budget << 20;
+        Board *board = board_create(workers * STEAL_PART_SIZE, STEAL_PART_SIZE, workers, &options);
+        if (board == NULL) {
+            printf("%8u %16s\n", budget, "-");
+            continue;
+        }
+
+        srand(1);
+        fill_random(board);
+        double start = now();
+        board_run(board, generations);
+        double elapsed = now() - start;
+
+        unsigned depth = board_get_undo_depth(board);
+        start = now();
+        board_undo(board, depth);
+        double undo_elapsed = now() - start;
+        board_destroy(board);
+
+        printf("%8u %16.2f %16u %16.2f\n",
+            budget,
+            elapsed / generations * 1e6,
+            depth,
+            depth == 0 ? 0 : undo_elapsed / depth * 1e6);
+    }
+
+    bool result = check_history_skip();
+    printf("undo after the skipped periods: %s\n", result ? "correct" : "WRONG");
+    return result;
+}
+
+//the mode of the bench is run with two optional positive numbers: the workers (or the most of them)
+//and the count of the instructions, the repeats or the generations, false if its check fails
+typedef struct Bench_mode
+{
+    const char *name;
+    bool (*run)(unsigned, unsigned);
+    unsigned default_workers;
+    unsigned default_count;
+} Bench_mode;
+
+static const Bench_mode modes[] = {
+    {"dispatch", bench_dispatch, DEFAULT_MAX_WORKERS, DEFAULT_INSTRUCTIONS},
+    {"startup", bench_startup, DEFAULT_STARTUP_WORKERS, DEFAULT_STARTUP_REPEATS},
+    {"halo", bench_halo, DEFAULT_HALO_WORKERS, DEFAULT_GENERATIONS},
+    {"schedule", bench_schedule, DEFAULT_SCHEDULE_WORKERS, DEFAULT_GENERATIONS},
+    {"steal", bench_steal, DEFAULT_HALO_WORKERS, DEFAULT_GENERATIONS},
+    {"rebalance", bench_rebalance, DEFAULT_HALO_WORKERS, DEFAULT_GENERATIONS},
+    {"affinity", bench_affinity, DEFAULT_HALO_WORKERS, DEFAULT_GENERATIONS},
+    {"history", bench_history, DEFAULT_HALO_WORKERS, DEFAULT_GENERATIONS}
+};
+
+static bool
+parse_params(int argc, char *argv[], const Bench_mode *mode, unsigned *workers, unsigned *count)
+{
+    if (argc > 4) {
+        return false;
+    }
+    *workers = argc > 2 ? atoi(argv[2]) : mode->default_workers;
+    *count = argc > 3 ? atoi(argv[3]) : mode->default_count;
+    return *workers != 0 && *count != 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    //children of the board must not flush the inherited buffer
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    for (unsigned k = 0; k < sizeof(modes) / sizeof(*modes) && argc >= 2; k++) {
+        unsigned workers;
+        unsigned count;
+        if (strcmp(argv[1], modes[k].name) == 0 && parse_params(argc, argv, &modes[k], &workers, &count)) {
+            return modes[k].run(workers, count) ? 0 : 2;
+        }
+    }
+
+    fprintf(stderr, "%s\n", USAGE_INFO);
+    return 1;
+}
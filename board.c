@@ -1,23 +1,56 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
 #include <math.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/ipc.h>
-#include <sys/shm.h>
 #include <sys/sem.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "core.h"
 #include "board.h"
+#include "barrier.h"
+#include "hashlife.h"
+#include "affinity.h"
 
 enum
 {
     IPC_CREAT_RW = IPC_CREAT | 0666
 };
 
-static void board_chunks_create(Board *board);
+static void board_workers_create(Board *board);
+static void board_workers_destroy(Board *board);
+
+static inline unsigned long long
+clock_ns(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+//neighbours of the chunk, in the order of Frame_side
+enum
+{
+    DIRECTIONS_COUNT = FRAME_NEIGHBOURS_COUNT
+};
+
+static const int directions[DIRECTIONS_COUNT][2] = {
+    {-1, -1}, {0, -1}, {+1, -1},
+    {-1,  0},          {+1,  0},
+    {-1, +1}, {0, +1}, {+1, +1}
+};
 
 static inline unsigned
 div_round_up(unsigned dividend, unsigned divider)
@@ -63,66 +96,265 @@ calc_max_cell_size(
     return min <= max ? max : 0;
 }
 
-static inline bool
-border_ids_has_special(Border_ids *border_ids)
+//the chunks have two frames: the workers read the current frames of the neighbours,
+//while the next ones are being written, the statuses have the halves for both of them
+enum
+{
+    CHUNK_FRAMES = 2
+};
+
+static inline unsigned
+chunk_width(Board *board, unsigned chunk_num_x)
 {
-    return border_ids->top == -1 || border_ids->bottom == -1;
+    return board->col_starts[chunk_num_x + 1] - board->col_starts[chunk_num_x];
 }
 
-static inline Border_ids *
-border_ids_create(
-    unsigned chunk_size,
-    unsigned last_width,
-    unsigned last_height,
-    bool frst_row,
-    bool frst_col,
-    bool last_row,
-    bool last_col)
+static inline unsigned
+chunk_height(Board *board, unsigned chunk_num_y)
 {
-    Border_ids *result = calloc(1, sizeof(*result));
+    return board->row_starts[chunk_num_y + 1] - board->row_starts[chunk_num_y];
+}
 
-    unsigned cur_width = last_row ? last_width : chunk_size;
-    unsigned cur_height = last_col ? last_height : chunk_size;
+//all of the memory, shared by the master and the workers (the instruction, the barrier,
+//the exported cells, the frames, the special areas and the statuses of the chunks),
+//is one arena: for the processes it's one shared mapping, made before the fork,
+//so the children inherit it, and there are no segments to attach, remove or run out of
+//the parts are aligned to the cache line, so the different workers don't write the same lines
+enum
+{
+    ARENA_ALIGNMENT = 64,
+    ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024
+};
 
-    if (!frst_row) {
-        result->top = shmget(IPC_PRIVATE, cur_width * sizeof(Cell), IPC_CREAT_RW);
-    } else {
-        result->top = -1;
+static inline size_t
+arena_round(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+//the words of the history of the chunk: its share of the budget by the area
+static size_t
+chunk_history_capacity(Board *board, unsigned cur_width, unsigned cur_height)
+{
+    double share = (double) cur_width * cur_height / ((double) board->width * board->height);
+    return (size_t) (board->history_budget / sizeof(Cell_word) * share);
+}
+
+//the parts of the chunk, which are taken by chunk_segments_create
+static size_t
+chunk_segments_size(Board *board, unsigned cur_width, unsigned cur_height)
+{
+    size_t result = CHUNK_FRAMES * arena_round(frame_buffer_size(cur_width, cur_height, board->halo_depth));
+    result += arena_round(chunk_buffer_size(CHUNK_FRAMES));
+    result += arena_round(cur_width * sizeof(char)) + arena_round(sizeof(Chunk_status));
+    result += arena_round(chunk_history_capacity(board, cur_width, cur_height) * sizeof(Cell_word));
+    return result;
+}
+
+//with the affinity the chunk starts from its own page, which is bound to the node of its worker,
+//but the padding to the page can't be larger, than the chunk: the smaller chunks (than the huge
+//page, usually) share the pages and aren't bound, so the padding is at most the size of the chunks
+static inline bool
+chunk_bound(Board *board, size_t segments_size)
+{
+    return board->affinity != BOARD_AFFINITY_NONE && segments_size >= board->arena_page_size;
+}
+
+//the sum of the parts, which are taken by board_arena_take
+static size_t
+board_arena_size(Board *board)
+{
+    size_t result = arena_round(sizeof(Instruction)) + arena_round((size_t) board->row_size * board->height);
+    if (board->sync == BOARD_SYNC_FUTEX) {
+        result += arena_round(sizeof(Barrier));
+    }
+    if (board->chunks_per_worker > 1) {
+        result += arena_round(sizeof(Barrier));
     }
+    result += board->workers_count * arena_round(sizeof(Worker_status));
 
-    if (!frst_col) {
-        result->left = shmget(IPC_PRIVATE, cur_height * sizeof(Cell), IPC_CREAT_RW);
-    } else {
-        result->left = -1;
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            size_t segments_size = chunk_segments_size(board, chunk_width(board, i), chunk_height(board, j));
+            result += segments_size;
+            if (chunk_bound(board, segments_size)) {
+                result += board->arena_page_size;
+            }
+        }
     }
+    return result;
+}
 
-    if (!last_col) {
-        result->right = shmget(IPC_PRIVATE, cur_height * sizeof(Cell), IPC_CREAT_RW);
-    } else {
-        result->right = -1;
+//the huge pages are tried first, if they are requested, the normal ones are the fallback
+static bool
+board_arena_create(Board *board)
+{
+    int flags = (board->backend == BOARD_BACKEND_THREADS ? MAP_PRIVATE : MAP_SHARED) | MAP_ANONYMOUS;
+    void *arena = MAP_FAILED;
+    size_t size = 0;
+    board->arena_pages = BOARD_PAGES_NORMAL;
+    if (board->huge_pages) {
+        board->arena_page_size = ARENA_HUGE_PAGE_SIZE;
+        size = (board_arena_size(board) + ARENA_HUGE_PAGE_SIZE - 1) / ARENA_HUGE_PAGE_SIZE * ARENA_HUGE_PAGE_SIZE;
+        arena = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (arena != MAP_FAILED) {
+            board->arena_pages = BOARD_PAGES_HUGETLB;
+        }
     }
 
-    if (!last_row) {
-        result->bottom = shmget(IPC_PRIVATE, cur_width * sizeof(Cell), IPC_CREAT_RW);
-    } else {
-        result->bottom = -1;
+    if (arena == MAP_FAILED) {
+        board->arena_page_size = sysconf(_SC_PAGESIZE);
+        size = board_arena_size(board);
+        arena = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (arena == MAP_FAILED) {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (board->huge_pages && madvise(arena, size, MADV_HUGEPAGE) == 0) {
+            board->arena_pages = BOARD_PAGES_TRANSPARENT;
+        }
+#endif
     }
 
-    if (border_ids_has_special(result)) {
-        result->special = shmget(IPC_PRIVATE, cur_width * sizeof(Cell), IPC_CREAT_RW);
-    } else {
-        result->special = result->top != -1 ? result->top : result->bottom;
+    board->arena = arena;
+    board->arena_size = size;
+    board->arena_used = 0;
+    return true;
+}
+
+//zeroed part of the arena, aligned to the cache line
+static void *
+board_arena_take(Board *board, size_t size)
+{
+    void *result = (char *) board->arena + board->arena_used;
+    board->arena_used += arena_round(size);
+    return result;
+}
+
+//node is the numa node of the worker of the chunk, negative without the affinity
+static inline Chunk_segments *
+chunk_segments_create(Board *board, unsigned cur_width, unsigned cur_height, int node)
+{
+    Chunk_segments *result = calloc(1, sizeof(*result));
+
+    //the parts of the chunk start from their own page, which is allocated on the node of the worker
+    //(the neighbours read the borders from there), the master touches it first in frame_create
+    size_t segments_size = chunk_segments_size(board, cur_width, cur_height);
+    if (node >= 0 && chunk_bound(board, segments_size)) {
+        size_t page_size = board->arena_page_size;
+        board->arena_used = (board->arena_used + page_size - 1) / page_size * page_size;
+        if (affinity_bind_memory((char *) board->arena + board->arena_used, segments_size, page_size, node)) {
+            board->bound_chunks_count += 1;
+        }
     }
 
+    //the chunk and its frames are in the arena, so any of the workers can calculate it
+    size_t frame_size = frame_buffer_size(cur_width, cur_height, board->halo_depth);
+    result->chunk = chunk_create(
+        board_arena_take(board, chunk_buffer_size(CHUNK_FRAMES)),
+        CHUNK_FRAMES,
+        frame_create(cur_width, cur_height, board->halo_depth, board_arena_take(board, frame_size)),
+        frame_create(cur_width, cur_height, board->halo_depth, board_arena_take(board, frame_size)));
+
+    //the frames are always in use, so the scanlines are passed through a separate area
+    result->special = board_arena_take(board, cur_width * sizeof(char));
+
+    result->status = board_arena_take(board, sizeof(*result->status));
+    progress_init(&result->status->progress);
+
+    //the status is in the arena too, so any of the workers appends the turns of the chunk
+    size_t history_capacity = chunk_history_capacity(board, cur_width, cur_height);
+    result->status->history = board_arena_take(board, history_capacity * sizeof(Cell_word));
+    result->status->history_capacity = history_capacity;
+
     return result;
 }
 
-Board *
-board_create(unsigned width, unsigned height, unsigned chunks_count)
+//the shared parts are freed with the arena
+static void
+chunk_segments_destroy(Chunk_segments *segments)
 {
-    if (width == 0 || height == 0 || chunks_count == 0) {
-        return NULL;
+    chunk_destroy(segments->chunk);
+    free(segments);
+}
+
+//every frame reads the borders from the frames of the neighbours with the same number:
+//all of the chunks make the same turns, so they are of the same generation
+static void
+board_link_frames(Board *board)
+{
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            Chunk *chunk = board->segments[j][i]->chunk;
+            for (unsigned k = 0; k < chunk->frames_count; k++) {
+                Frame *neighbours[DIRECTIONS_COUNT];
+                for (unsigned d = 0; d < DIRECTIONS_COUNT; d++) {
+                    int x = (int) i + directions[d][0];
+                    int y = (int) j + directions[d][1];
+                    neighbours[d] = NULL;
+                    if (x >= 0 && x < (int) board->chunks_hor_count &&
+                        y >= 0 && y < (int) board->chunks_ver_count) {
+                        neighbours[d] = board->segments[y][x]->chunk->frames[k];
+                    }
+                }
+                frame_set_neighbours(chunk->frames[k], neighbours);
+            }
+        }
     }
+}
+
+//the deque of the worker is one word: the parity of the round, the top and the bottom
+//of the range of its chunks, so both ends are taken by one compare and swap
+//the workers finish the round in the different time: the parity keeps the chunks of the next
+//round, which are put by the worker, who has finished, from the ones, who are still stealing
+enum
+{
+    DEQUE_BITS = 15,
+    DEQUE_MASK = BOARD_MAX_CHUNKS_PER_WORKER,
+    DEQUE_ROUND_SHIFT = 2 * DEQUE_BITS
+};
+
+static inline unsigned
+deque_pack(unsigned round, unsigned top, unsigned bottom)
+{
+    return (round & 1) << DEQUE_ROUND_SHIFT | top << DEQUE_BITS | bottom;
+}
+
+//all of the chunks of the worker for the round
+static inline void
+worker_deque_reset(Board *board, unsigned worker_num, unsigned round)
+{
+    atomic_store(&board->workers_statuses[worker_num]->deque, deque_pack(round, 0, board->chunks_per_worker));
+}
+
+//takes the position of the chunk of the round from the bottom (for the owner) or the top
+//(for the thieves) of the deque, returns false, if there are no chunks of this round
+static bool
+worker_deque_take(Worker_status *status, unsigned round, bool from_bottom, unsigned *chunk_pos)
+{
+    unsigned value = atomic_load_explicit(&status->deque, memory_order_relaxed);
+    unsigned next;
+    do {
+        unsigned top = (value >> DEQUE_BITS) & DEQUE_MASK;
+        unsigned bottom = value & DEQUE_MASK;
+        if (value >> DEQUE_ROUND_SHIFT != (round & 1) || top == bottom) {
+            return false;
+        }
+        *chunk_pos = from_bottom ? bottom - 1 : top;
+        next = from_bottom ? deque_pack(round, top, bottom - 1) : deque_pack(round, top + 1, bottom);
+    } while (!atomic_compare_exchange_weak(&status->deque, &value, next));
+    return true;
+}
+
+//the partitions fill chunks_hor_count, chunks_ver_count, col_starts and row_starts
+//of the board, or return false, if the board can't be split into the count of the chunks
+
+//squares of the largest size, for which the count of the chunks fits the board
+static bool
+partition_squares(Board *board, unsigned chunks_count)
+{
+    unsigned width = board->width;
+    unsigned height = board->height;
 
     unsigned chunk_size = 0;
     unsigned chunks_hor;
@@ -154,330 +386,1582 @@ board_create(unsigned width, unsigned height, unsigned chunks_count)
     }
 
     if (chunk_size == 0) {
-        return NULL;
+        return false;
     }
 
-    unsigned last_width = width - (chunks_hor - 1) * chunk_size;
-    unsigned last_height = height - (chunks_ver - 1) * chunk_size;
+    board->chunks_hor_count = chunks_hor;
+    board->chunks_ver_count = chunks_ver;
+    board->col_starts = calloc(chunks_hor + 1, sizeof(*board->col_starts));
+    board->row_starts = calloc(chunks_ver + 1, sizeof(*board->row_starts));
+    for (unsigned i = 0; i < chunks_hor; i++) {
+        board->col_starts[i] = i * chunk_size;
+    }
+    board->col_starts[chunks_hor] = width;
+    for (unsigned j = 0; j < chunks_ver; j++) {
+        board->row_starts[j] = j * chunk_size;
+    }
+    board->row_starts[chunks_ver] = height;
+    return true;
+}
 
-    Board *result = calloc(1, sizeof(*result));
+//the estimated work of the chunk is the number of its cells and of the cells of the halo,
+//which are copied from the neighbours and, with the deep halo, calculated again:
+//(halo_depth + 1) / 2 rows or columns in average on every side with a neighbour
+static inline double
+partition_side_cost(unsigned halo_depth)
+{
+    return (halo_depth + 1) / 2.0;
+}
 
-    result->width = width;
-    result->height = height;
+//splits the line of length cells into parts_count parts with the equal estimated work:
+//the sum of the weights of the cells (NULL for the equal ones) and side_cost for every
+//neighbour part, so the first and the last parts are larger
+//every part has at least min_size cells, starts has parts_count + 1 elements
+static void
+partition_line(
+    const double *weights,
+    unsigned length,
+    unsigned parts_count,
+    double side_cost,
+    unsigned min_size,
+    unsigned *starts)
+{
+    double total = side_cost * 2 * (parts_count - 1);
+    for (unsigned i = 0; i < length; i++) {
+        total += weights == NULL ? 1 : weights[i];
+    }
+    double target = total / parts_count;
+
+    starts[0] = 0;
+    unsigned pos = 0;
+    double weight = 0; //of the cells before pos
+    for (unsigned k = 1; k < parts_count; k++) {
+        //the work of the parts before the bound k: their cells and 2k - 1 sides
+        double goal = target * k - side_cost * (2 * k - 1);
+        unsigned frst = starts[k - 1] + min_size;
+        unsigned last = length - (parts_count - k) * min_size;
+        for (; pos < last; pos++) {
+            double cell = weights == NULL ? 1 : weights[pos];
+            if (pos >= frst && weight + cell / 2 > goal) {
+                break;
+            }
+            weight += cell;
+        }
+        starts[k] = pos;
+    }
+    starts[parts_count] = length;
+}
 
-    result->chunks_count = chunks_count;
-    result->chunks_hor_count = chunks_hor;
-    result->chunks_ver_count = chunks_ver;
+//columns and rows of the chunks (or only rows for the strips), the numbers of them are
+//selected by the least estimated work of the chunk, their sizes equalize it
+static bool
+partition_grid(Board *board, unsigned chunks_count, unsigned halo_depth, bool strips)
+{
+    unsigned width = board->width;
+    unsigned height = board->height;
+    double side_cost = partition_side_cost(halo_depth);
+
+    unsigned chunks_hor = 0;
+    unsigned chunks_ver = 0;
+    double min_work = 0;
+    for (unsigned cols = 1; cols <= (strips ? 1 : chunks_count); cols++) {
+        unsigned rows = chunks_count / cols;
+        if (chunks_count % cols != 0 || cols > width || rows > height) {
+            continue;
+        }
 
-    result->chunk_size = chunk_size;
+        double work =
+            ((double) width / cols + (cols > 1 ? 2 * side_cost : 0)) *
+            ((double) height / rows + (rows > 1 ? 2 * side_cost : 0));
+        if (chunks_hor == 0 || work < min_work) {
+            chunks_hor = cols;
+            chunks_ver = rows;
+            min_work = work;
+        }
+    }
+
+    if (chunks_hor == 0) {
+        return false;
+    }
 
-    result->last_width = last_width;
-    result->last_height = last_height;
+    //the halo can't be deeper than the chunks, so they aren't made thinner, if possible
+    unsigned min_width = width / chunks_hor < halo_depth ? width / chunks_hor : halo_depth;
+    unsigned min_height = height / chunks_ver < halo_depth ? height / chunks_ver : halo_depth;
 
-    result->generation_num = 1;
+    board->chunks_hor_count = chunks_hor;
+    board->chunks_ver_count = chunks_ver;
+    board->col_starts = calloc(chunks_hor + 1, sizeof(*board->col_starts));
+    board->row_starts = calloc(chunks_ver + 1, sizeof(*board->row_starts));
+    partition_line(NULL, width, chunks_hor, side_cost, min_width, board->col_starts);
+    partition_line(NULL, height, chunks_ver, side_cost, min_height, board->row_starts);
+    return true;
+}
 
-    result->chunks = calloc(chunks_ver, sizeof(*result->chunks));
-    result->border_ids = calloc(chunks_ver, sizeof(*result->border_ids));
-    result->special_pointers = calloc(chunks_ver, sizeof(*result->special_pointers));
+//the chunks by the starts of the board, the arena with them and the workers
+static bool
+board_chunks_create(Board *board)
+{
+    unsigned workers_count = board->workers_count;
+    unsigned chunks_hor = board->chunks_hor_count;
+    unsigned chunks_ver = board->chunks_ver_count;
+
+    //the angles of the borders are taken from the diagonal neighbours,
+    //so the halo can't be deeper than the smallest chunk
+    unsigned min_size = board->max_halo_depth;
+    for (unsigned i = 0; i < chunks_hor; i++) {
+        if (chunk_width(board, i) < min_size) {
+            min_size = chunk_width(board, i);
+        }
+    }
     for (unsigned j = 0; j < chunks_ver; j++) {
-        result->chunks[j] = calloc(chunks_hor, sizeof(**result->chunks));
-        result->border_ids[j] = calloc(chunks_hor, sizeof(**result->border_ids));
-        result->special_pointers[j] = calloc(chunks_hor, sizeof(**result->special_pointers));
-
-        for (unsigned i = 0; i < chunks_hor; i++) {
-            result->border_ids[j][i] = border_ids_create(
-                chunk_size,
-                last_width,
-                last_height,
-                j == 0,
-                i == 0,
-                j == chunks_ver - 1,
-                i == chunks_hor - 1);
+        if (chunk_height(board, j) < min_size) {
+            min_size = chunk_height(board, j);
         }
     }
+    board->halo_depth = min_size;
 
-    result->sem_id = semget(IPC_PRIVATE, 2, IPC_CREAT_RW);
-    result->shm_id = shmget(IPC_PRIVATE, sizeof(*result->cur_instruction), IPC_CREAT_RW);
+    if (!board_arena_create(board)) {
+        return false;
+    }
 
-    board_chunks_create(result);
+    if (board->backend == BOARD_BACKEND_THREADS) {
+        board->threads = calloc(workers_count, sizeof(*board->threads));
+    } else {
+        board->workers = calloc(workers_count, sizeof(*board->workers));
+    }
+    board->workers_statuses = calloc(workers_count, sizeof(*board->workers_statuses));
+    for (unsigned k = 0; k < workers_count; k++) {
+        board->workers_statuses[k] = board_arena_take(board, sizeof(**board->workers_statuses));
+        worker_deque_reset(board, k, 0);
+    }
+    board->pool_barrier = NULL;
+    if (board->chunks_per_worker > 1) {
+        board->pool_barrier = board_arena_take(board, sizeof(*board->pool_barrier));
+        barrier_init(board->pool_barrier, workers_count);
+    }
 
-    result->cur_instruction = shmat(result->shm_id, NULL, 0);
+    board->segments = calloc(chunks_ver, sizeof(*board->segments));
+    board->bound_chunks_count = 0;
     for (unsigned j = 0; j < chunks_ver; j++) {
+        board->segments[j] = calloc(chunks_hor, sizeof(**board->segments));
+
         for (unsigned i = 0; i < chunks_hor; i++) {
-            result->special_pointers[j][i] = shmat(result->border_ids[j][i]->special, NULL, 0);
+            int node = -1;
+            if (board->affinity != BOARD_AFFINITY_NONE) {
+                unsigned worker_num = (j * chunks_hor + i) / board->chunks_per_worker;
+                node = board->cpus[worker_num % board->cpus_count].node;
+            }
+            board->segments[j][i] = chunk_segments_create(board, chunk_width(board, i), chunk_height(board, j), node);
         }
     }
+    board_link_frames(board);
 
-    return result;
+    if (board->sync == BOARD_SYNC_FUTEX) {
+        board->sem_id = -1;
+        board->barrier = board_arena_take(board, sizeof(*board->barrier));
+        barrier_init(board->barrier, workers_count + 1);
+        board->barrier_sense = 0;
+    } else {
+        board->sem_id = semget(IPC_PRIVATE, 2, IPC_CREAT_RW);
+        board->barrier = NULL;
+    }
+    board->cur_instruction = board_arena_take(board, sizeof(*board->cur_instruction));
+    board->cells = board_arena_take(board, (size_t) board->row_size * board->height);
+
+    board_workers_create(board);
+    return true;
 }
 
-static inline void *
-safe_shmat(int id)
+//the workers, the chunks and the arena, the starts stay
+static void
+board_chunks_destroy(Board *board)
 {
-    if (id == -1) {
-        return NULL;
-    } else {
-        return shmat(id, NULL, 0);
+    board_workers_destroy(board);
+
+    if (board->sync == BOARD_SYNC_SEMAPHORES) {
+        semctl(board->sem_id, 0, IPC_RMID, NULL);
+    }
+
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            chunk_segments_destroy(board->segments[j][i]);
+        }
+        free(board->segments[j]);
     }
+    free(board->segments);
+    free(board->threads);
+    free(board->workers);
+    free(board->workers_statuses);
+    board->threads = NULL;
+    board->workers = NULL;
+
+    munmap(board->arena, board->arena_size);
 }
 
-static inline void
-safe_shmdt(void *ptr)
+void
+board_options_init(Board_options *options)
 {
-    if (ptr != NULL) {
-        shmdt(ptr);
-    }
+    options->backend = BOARD_BACKEND_PROCESSES;
+    options->partition = BOARD_PARTITION_SQUARES;
+    options->chunks_per_worker = 1;
+    options->rebalance_interval = 0;
+    options->rebalance_threshold = 10;
+    options->sync = BOARD_SYNC_FUTEX;
+    options->affinity = BOARD_AFFINITY_NONE;
+    options->huge_pages = false;
+    options->history_budget = 0;
+    options->hashlife_max_nodes = HASHLIFE_DEFAULT_MAX_NODES;
+    options->halo_depth = 1;
+    options->max_period = BOARD_MAX_PERIOD;
 }
 
-static void
-free_borders(Borders *borders)
+//the whole board is one quadtree, there are no chunks and workers
+static Board *
+board_create_hashlife(unsigned width, unsigned height, const Board_options *options)
 {
-    safe_shmdt(borders->top_side);
-    safe_shmdt(borders->left_side);
-    safe_shmdt(borders->right_side);
-    safe_shmdt(borders->bottom_side);
+    Hashlife *hashlife = hashlife_create(width, height, options->hashlife_max_nodes);
+    if (hashlife == NULL) {
+        return NULL;
+    }
 
-    free(borders);
+    Board *result = calloc(1, sizeof(*result));
+    result->backend = BOARD_BACKEND_HASHLIFE;
+    result->hashlife = hashlife;
+    result->width = width;
+    result->height = height;
+    result->generation_num = 1;
+    result->row_size = (width + 7) / 8;
+    result->cells = calloc((size_t) result->row_size * height, sizeof(*result->cells));
+    return result;
 }
 
-static void
-board_chunks_create(Board *board)
+Board *
+board_create(unsigned width, unsigned height, unsigned workers_count, const Board_options *options)
 {
-    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
-        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
-            if (!(board->chunks[j][i] = fork())) {
-                unsigned chunk_num_x = i;
-                unsigned chunk_num_y = j;
-
-                bool frst_row = chunk_num_y == 0;
-                bool frst_col = chunk_num_x == 0;
-                bool last_col = chunk_num_x == board->chunks_hor_count - 1;
-                bool last_row = chunk_num_y == board->chunks_ver_count - 1;
+    Board_options default_options;
+    if (options == NULL) {
+        board_options_init(&default_options);
+        options = &default_options;
+    }
 
-                unsigned width = last_col ? board->last_width : board->chunk_size;
-                unsigned height = last_row ? board->last_height : board->chunk_size;
+    if (width == 0 || height == 0 || workers_count == 0) {
+        return NULL;
+    }
+    if (options->backend == BOARD_BACKEND_HASHLIFE) {
+        return board_create_hashlife(width, height, options);
+    }
 
-                Borders *inner = calloc(1, sizeof(*inner));
-                Borders *outer = calloc(1, sizeof(*outer));
+    unsigned chunks_per_worker = options->chunks_per_worker == 0 ? 1 : options->chunks_per_worker;
+    if (chunks_per_worker > BOARD_MAX_CHUNKS_PER_WORKER ||
+        workers_count > UINT_MAX / chunks_per_worker) {
+        return NULL;
+    }
+    unsigned chunks_count = workers_count * chunks_per_worker;
 
-                Border_ids *cur_border_ids = board->border_ids[j][i];
+    Board *result = calloc(1, sizeof(*result));
 
-                inner->top_side = safe_shmat(cur_border_ids->top);
-                inner->left_side = safe_shmat(cur_border_ids->left);
-                inner->right_side = safe_shmat(cur_border_ids->right);
-                inner->bottom_side = safe_shmat(cur_border_ids->bottom);
+    result->width = width;
+    result->height = height;
+    result->workers_count = workers_count;
+    result->chunks_per_worker = chunks_per_worker;
 
-                char *special_pointer;
-                if (border_ids_has_special(cur_border_ids)) {
-                    special_pointer = safe_shmat(cur_border_ids->special);
-                } else {
-                    special_pointer = (char *) (inner->top_side != NULL ? inner->top_side : inner->bottom_side);
-                }
+    unsigned halo_depth = options->halo_depth == 0 ? 1 : options->halo_depth;
+    bool partitioned;
+    if (options->partition == BOARD_PARTITION_SQUARES) {
+        partitioned = partition_squares(result, chunks_count);
+    } else {
+        partitioned = partition_grid(
+            result,
+            chunks_count,
+            halo_depth,
+            options->partition == BOARD_PARTITION_STRIPS);
+    }
+    if (!partitioned) {
+        free(result);
+        return NULL;
+    }
+    result->chunks_count = chunks_count;
 
-                if (!frst_row) {
-                    outer->top_side = safe_shmat(board->border_ids[j - 1][i]->bottom);
-                    if (!frst_col) {
-                        outer->tl_angle = safe_shmat(board->border_ids[j - 1][i - 1]->bottom);
-                        outer->tl_angle += board->chunk_size - 1;
-                    } else {
-                        outer->tl_angle = NULL;
-                    }
-                    if (!last_col) {
-                        outer->tr_angle = safe_shmat(board->border_ids[j - 1][i + 1]->bottom);
-                    } else {
-                        outer->tr_angle = NULL;
-                    }
-                } else {
-                    outer->top_side = NULL;
-                    outer->tl_angle = NULL;
-                    outer->tr_angle = NULL;
-                }
+    //select the kernel once, before the workers are forked
+    frame_select_kernel();
 
-                if (!frst_col) {
-                    outer->left_side = safe_shmat(board->border_ids[j][i - 1]->right);
-                } else {
-                    outer->left_side = NULL;
-                }
+    result->generation_num = 1;
 
-                if (!last_col) {
-                    outer->right_side = safe_shmat(board->border_ids[j][i + 1]->left);
-                } else {
-                    outer->right_side = NULL;
-                }
+    result->backend = options->backend;
+    result->sync = options->sync;
+    result->huge_pages = options->huge_pages;
 
-                if (!last_row) {
-                    outer->bottom_side = safe_shmat(board->border_ids[j + 1][i]->top);
-                    if (!frst_col) {
-                        outer->bl_angle = safe_shmat(board->border_ids[j + 1][i - 1]->top);
-                        outer->bl_angle += board->chunk_size - 1;
-                    } else {
-                        outer->bl_angle = NULL;
-                    }
-                    if (!last_col) {
-                        outer->br_angle = safe_shmat(board->border_ids[j + 1][i + 1]->top);
-                    } else {
-                        outer->br_angle = NULL;
-                    }
-                } else {
-                    outer->bottom_side = NULL;
-                    outer->bl_angle = NULL;
-                    outer->br_angle = NULL;
-                }
+    //the topology is read once, the rebalanced chunks are placed by it again
+    result->affinity = options->affinity;
+    if (result->affinity != BOARD_AFFINITY_NONE) {
+        result->cpus_count = affinity_cpus(&result->cpus);
+        if (result->cpus_count == 0) {
+            result->affinity = BOARD_AFFINITY_NONE;
+        }
+    }
 
-                Frame *frame_one = frame_create(width, height, inner, outer);
-                Frame *frame_two = frame_create(width, height, inner, outer);
-                Frame *cur_frame;
-                Chunk *chunk = chunk_create(2, frame_one, frame_two);
-
-                Instruction *instruction = safe_shmat(board->shm_id);
-                struct sembuf *operation = calloc(1, sizeof(*operation));
-                char *scanline;
-                bool terminate = false;
-                do {
-                    operation->sem_num = 0;
-                    operation->sem_op = -1;
-                    semop(board->sem_id, operation, 1);
-
-                    if ((instruction->chunk_num_x == chunk_num_x ||
-                        instruction->chunk_num_x == CHUNK_NUM_ANY) &&
-                        (instruction->chunk_num_y == chunk_num_y ||
-                        instruction->chunk_num_y == CHUNK_NUM_ANY)) {
-                        cur_frame = chunk->cur_frame;
-                        switch (instruction->id) {
-                            case INSTRUCTION_DESTROY:
-                                terminate = true;
-                                break;
-                            case INSTRUCTION_ADD_CELL:
-                                frame_set_cell(cur_frame, instruction->param1, instruction->param2, CELL_ALIVE);
-                                break;
-                            case INSTRUCTION_WRITE_SCANLINE:
-                                scanline = frame_render_line(cur_frame, instruction->param1);
-                                memcpy(special_pointer, scanline, width);
-                                free(scanline);
-                                break;
-                            case INSTRUCTION_READ_SCANLINE:
-                                scanline = calloc(width + 1, sizeof(*scanline));
-                                memcpy(scanline, special_pointer, width);
-                                frame_load_line(cur_frame, scanline, instruction->param1);
-                                free(scanline);
-                                break;
-                            case INSTRUCTION_UPDATE_INNER_BORDERS:
-                                frame_update_inner_borders(cur_frame);
-                                break;
-                            case INSTRUCTION_UPDATE_OUTER_BORDERS:
-                                frame_update_outer_borders(cur_frame);
-                                break;
-                            case INSTRUCTION_CALCULATE:
-                                frame_calc(chunk_switch_next_frame(chunk), cur_frame);
-                                break;
-                            case INSTRUCTION_CLEAR:
-                                chunk_clear(chunk);
-                                break;
-                            case INSTRUCTION_NOP:
-                            default:
-                                break;
-                        }
-                    }
+    result->history_budget = options->history_budget;
+    result->max_halo_depth = halo_depth;
+    result->rebalance_interval = options->rebalance_interval;
+    result->rebalance_threshold = options->rebalance_threshold;
+    result->max_period = options->max_period < BOARD_MAX_PERIOD ? options->max_period : BOARD_MAX_PERIOD;
+    result->row_size = (width + 7) / 8;
+
+    if (!board_chunks_create(result)) {
+        free(result->cpus);
+        free(result->col_starts);
+        free(result->row_starts);
+        free(result);
+        return NULL;
+    }
+    return result;
+}
 
-                    operation->sem_num = 0;
-                    operation->sem_op = 0;
-                    semop(board->sem_id, operation, 1);
+//the instruction protocol, the master calls board_send_instruction
+//with BOARD_SYNC_FUTEX it's two barriers of the master and all of the workers
+//with BOARD_SYNC_SEMAPHORES the master adds workers_count to the first semaphore,
+//each worker takes 1 and, after finishing, waits while the others take theirs,
+//and reports to the second semaphore, which is taken by the master
+static void
+worker_wait_instruction(Board *board, unsigned *barrier_sense)
+{
+    if (board->sync == BOARD_SYNC_FUTEX) {
+        barrier_wait(board->barrier, barrier_sense);
+    } else {
+        struct sembuf operation = {.sem_num = 0, .sem_op = -1, .sem_flg = 0};
+        semop(board->sem_id, &operation, 1);
+    }
+}
 
-                    operation->sem_num = 1;
-                    operation->sem_op = +1;
-                    semop(board->sem_id, operation, 1);
-                } while (!terminate);
+static void
+worker_finish_instruction(Board *board, unsigned *barrier_sense)
+{
+    if (board->sync == BOARD_SYNC_FUTEX) {
+        barrier_wait(board->barrier, barrier_sense);
+    } else {
+        struct sembuf operation = {.sem_num = 0, .sem_op = 0, .sem_flg = 0};
+        semop(board->sem_id, &operation, 1);
 
-                free(operation);
-                shmdt(instruction);
+        operation.sem_num = 1;
+        operation.sem_op = +1;
+        semop(board->sem_id, &operation, 1);
+    }
+}
 
-                chunk_destroy(chunk);
+//the hash of the current frame is published for the master as the one of the turn
+static inline void
+worker_record_hash(Chunk *chunk, Chunk_status *status, unsigned long long turns)
+{
+    status->hashes[turns % BOARD_HISTORY_LENGTH] = chunk->cur_frame->hash;
+}
 
-                if (border_ids_has_special(cur_border_ids)) {
-                    shmdt(special_pointer);
-                }
+//the history of the chunk starts anew, when its cells are changed not by the turn
+static inline void
+chunk_history_clear(Chunk_status *status)
+{
+    status->history_begin = status->history_end;
+    status->history_redo_end = status->history_end;
+    status->history_count = 0;
+    status->history_redo_count = 0;
+}
 
-                free_borders(outer);
-                free_borders(inner);
+//appends the delta of the turn, which is just made (from the other frame),
+//the oldest records are dropped to fit it, the undone ones can't be redone after it
+static void
+chunk_history_push(Chunk *chunk, Chunk_status *status, bool changed)
+{
+    unsigned long long capacity = status->history_capacity;
+    if (capacity == 0) {
+        return;
+    }
 
-                exit(0);
-            }
-        }
+    Cell_word *ring = status->history;
+    Frame *prev_frame = chunk->frames[(chunk->cur_frame_num + 1) % CHUNK_FRAMES];
+    unsigned long long size = changed ? frame_delta_size(chunk->cur_frame, prev_frame) : 0;
+    status->history_redo_end = status->history_end;
+    status->history_redo_count = 0;
+    if (size + 2 > capacity) {
+        //the generation doesn't fit in the budget, so nothing before it can be undone
+        chunk_history_clear(status);
+        return;
+    }
+    while (status->history_end + size + 2 - status->history_begin > capacity) {
+        status->history_begin += ring[status->history_begin % capacity] + 2;
+        status->history_count--;
     }
+
+    unsigned long long end = status->history_end;
+    ring[end % capacity] = size;
+    frame_delta_write(chunk->cur_frame, prev_frame, ring, capacity, (end + 1) % capacity);
+    ring[(end + 1 + size) % capacity] = size;
+    status->history_end = end + size + 2;
+    status->history_redo_end = status->history_end;
+    status->history_count++;
 }
 
+//INSTRUCTION_UNDO: the last records are xored into the current frame, they stay for the redo
 static void
-board_send_instruction(Board *board)
+chunk_history_undo(Chunk *chunk, Chunk_status *status, unsigned generations)
 {
-    struct sembuf *operation = calloc(1, sizeof(*operation));
-    operation->sem_num = 0;
-    operation->sem_op = board->chunks_count;
-    semop(board->sem_id, operation, 1);
-    operation->sem_num = 1;
-    operation->sem_op = -board->chunks_count;
-    semop(board->sem_id, operation, 1);
-    free(operation);
+    unsigned long long capacity = status->history_capacity;
+    Cell_word *ring = status->history;
+    for (unsigned k = 0; k < generations && status->history_count > 0; k++) {
+        unsigned long long size = ring[(status->history_end - 1) % capacity];
+        status->history_end -= size + 2;
+        frame_delta_apply(chunk->cur_frame, ring, capacity, (status->history_end + 1) % capacity, size);
+        status->history_count--;
+        status->history_redo_count++;
+    }
 }
 
-static inline unsigned
-get_chunk_num(unsigned coord, unsigned chunk_size, unsigned chunk_count)
+//INSTRUCTION_REDO: the undone records are xored again
+static void
+chunk_history_redo(Chunk *chunk, Chunk_status *status, unsigned generations)
 {
-    unsigned result = (coord - 1) / chunk_size;
-    if (result >= chunk_count) {
-        result = chunk_count - 1;
+    unsigned long long capacity = status->history_capacity;
+    Cell_word *ring = status->history;
+    for (unsigned k = 0; k < generations && status->history_redo_count > 0; k++) {
+        unsigned long long size = ring[status->history_end % capacity];
+        frame_delta_apply(chunk->cur_frame, ring, capacity, (status->history_end + 1) % capacity, size);
+        status->history_end += size + 2;
+        status->history_count++;
+        status->history_redo_count--;
     }
-    return result;
 }
 
-static inline unsigned
-get_chunk_coord(unsigned coord, unsigned chunk_size, unsigned chunk_count)
+static inline void
+worker_record_turn(Chunk *chunk, Chunk_status *status, unsigned long long *turns, bool changed)
 {
-    return coord - chunk_size * get_chunk_num(coord, chunk_size, chunk_count);
+    chunk_history_push(chunk, status, changed);
+    (*turns)++;
+    worker_record_hash(chunk, status, *turns);
+    status->turn_changed[*turns % BOARD_HISTORY_LENGTH] = changed;
 }
 
-bool
-board_add_cell(Board *board, unsigned x, unsigned y)
+//the chunk or any of its neighbours changed in the last turn, by the half of the statuses
+static inline bool
+chunk_active(Chunk_status *status, Chunk_status **neighbours_statuses, unsigned neighbours_count, unsigned half)
 {
-    if (x < 1 || x > board->width || y < 1|| y > board->height) {
-        return false;
+    bool result = status->changed[half];
+    for (unsigned k = 0; k < neighbours_count && !result; k++) {
+        result = neighbours_statuses[k]->changed[half];
     }
+    return result;
+}
 
-    Instruction *instruction = board->cur_instruction;
-    instruction->id = INSTRUCTION_ADD_CELL;
-    instruction->chunk_num_x = get_chunk_num(x, board->chunk_size, board->chunks_hor_count);
-    instruction->chunk_num_y = get_chunk_num(y, board->chunk_size, board->chunks_ver_count);
-    instruction->param1 = get_chunk_coord(x, board->chunk_size, board->chunks_hor_count);
-    instruction->param2 = get_chunk_coord(y, board->chunk_size, board->chunks_ver_count);
-    board_send_instruction(board);
+//makes a turn of the chunk, if it or any of its neighbours changed in the last turn
+//otherwise the next frame already equals the current one (it's the previous generation,
+//which is the same), so it's enough to switch to it
+//returns false, if the turn is skipped
+static bool
+chunk_turn(
+    Chunk *chunk,
+    Chunk_status *status,
+    Chunk_status **neighbours_statuses,
+    unsigned neighbours_count,
+    unsigned long long *turns)
+{
+    if (chunk_active(status, neighbours_statuses, neighbours_count, chunk->cur_frame_num)) {
+        bool changed = chunk_do_turn(chunk);
+        status->changed[chunk->cur_frame_num] = changed;
+        worker_record_turn(chunk, status, turns, changed);
+        return true;
+    } else {
+        chunk_skip_turn(chunk);
+        status->changed[chunk->cur_frame_num] = false;
+        status->skipped_count++;
+        worker_record_turn(chunk, status, turns, false);
+        return false;
+    }
+}
+
+//statuses of the neighbour chunks, which the worker waits for during INSTRUCTION_RUN
+typedef struct Worker_neighbours
+{
+    Chunk_status *statuses[DIRECTIONS_COUNT];
+    unsigned count;
+    unsigned spin_count;
+    unsigned long long wait_ns; //since the worker took it last time
+} Worker_neighbours;
+
+static void
+worker_neighbours_init(
+    Board *board,
+    unsigned chunk_num_x,
+    unsigned chunk_num_y,
+    unsigned spin_count,
+    Worker_neighbours *neighbours)
+{
+    neighbours->count = 0;
+    neighbours->spin_count = spin_count;
+    neighbours->wait_ns = 0;
+    for (unsigned k = 0; k < DIRECTIONS_COUNT; k++) {
+        int x = (int) chunk_num_x + directions[k][0];
+        int y = (int) chunk_num_y + directions[k][1];
+        if (x >= 0 && x < (int) board->chunks_hor_count &&
+            y >= 0 && y < (int) board->chunks_ver_count) {
+            neighbours->statuses[neighbours->count++] = board->segments[y][x]->status;
+        }
+    }
+}
+
+//tells the neighbours, that the next generation (or block) is published
+static inline void
+worker_publish(Chunk_status *status, unsigned *progress)
+{
+    (*progress)++;
+    progress_publish(&status->progress, *progress);
+}
+
+//waits, until all of the neighbours publish the given progress
+//(all of the workers count the same turns, so they're equal after every instruction)
+static inline void
+worker_wait_neighbours(Worker_neighbours *neighbours, unsigned progress)
+{
+    for (unsigned k = 0; k < neighbours->count; k++) {
+        //only the real waits are timed
+        Progress *neighbour = &neighbours->statuses[k]->progress;
+        if (!progress_check(neighbour, progress)) {
+            unsigned long long start = clock_ns();
+            progress_wait(neighbour, progress, neighbours->spin_count);
+            neighbours->wait_ns += clock_ns() - start;
+        }
+    }
+}
+
+//INSTRUCTION_RUN: before the turn the chunk waits only for its neighbours to finish
+//the previous one, so it can be ahead of the far chunks by the distance to them
+//the neighbours which finished the previous turn have read our borders
+//of the previous frame, so the half of the next frame can be written
+static void
+chunk_run(
+    Chunk *chunk,
+    Chunk_status *status,
+    Worker_neighbours *neighbours,
+    unsigned *progress,
+    unsigned long long *turns,
+    unsigned generations)
+{
+    for (unsigned k = 0; k < generations; k++) {
+        worker_wait_neighbours(neighbours, *progress);
+        chunk_turn(chunk, status, neighbours->statuses, neighbours->count, turns);
+        worker_publish(status, progress);
+    }
+}
+
+//INSTRUCTION_RUN with the deep halo: the chunks read the borders once in a block
+//of depth turns, the turns of the block are calculated on the shrinking region
+//the block writes both frames, so the chunk publishes twice in a block: when the block
+//is ready, and when the neighbours' frames are read, the frame, which the neighbours read,
+//is overwritten by the second turn, after all of them have read it
+//here the halves of the statuses are indexed by the block, not by the frame:
+//the block can have even number of turns, so the frame number can be the same,
+//while a neighbour is still checking the status of the previous block
+static void
+chunk_run_deep(
+    Board *board,
+    Chunk *chunk,
+    Chunk_status *status,
+    Worker_neighbours *neighbours,
+    unsigned *progress,
+    unsigned long long *turns,
+    unsigned generations)
+{
+    unsigned depth = board->halo_depth;
+    unsigned half = 0;
+
+    bool changed = status->changed[chunk->cur_frame_num];
+    status->changed[half] = changed;
+    worker_publish(status, progress);
+
+    unsigned done = 0;
+    while (done < generations) {
+        unsigned block_turns = generations - done < depth ? generations - done : depth;
+        worker_wait_neighbours(neighbours, *progress);
+
+        //the block is stable, if the chunk and its neighbours were stable in the last turn
+        if (chunk_active(status, neighbours->statuses, neighbours->count, half)) {
+            //the region, where the borders are still correct, shrinks by a cell every turn
+            frame_update_outer_borders(chunk->cur_frame);
+            worker_publish(status, progress);
+            for (unsigned k = 1; k <= block_turns; k++) {
+                if (k == 2) {
+                    worker_wait_neighbours(neighbours, *progress);
+                }
+                changed = chunk_do_deep_turn(chunk, block_turns - k);
+                worker_record_turn(chunk, status, turns, changed);
+            }
+        } else {
+            //the skipped turns change only the halo, which the neighbours don't read
+            worker_publish(status, progress);
+            for (unsigned k = 0; k < block_turns; k++) {
+                chunk_skip_turn(chunk);
+                worker_record_turn(chunk, status, turns, false);
+            }
+            changed = false;
+            status->skipped_count += block_turns;
+        }
+
+        half = (half + 1) % CHUNK_FRAMES;
+        status->changed[half] = changed;
+        worker_publish(status, progress);
+
+        done += block_turns;
+    }
+
+    //when the neighbours have checked the last block, return to the halves, indexed by the frame
+    //(the previous frame is unknown after the block)
+    worker_wait_neighbours(neighbours, *progress);
+    unsigned cur_frame_num = chunk->cur_frame_num;
+    status->changed[cur_frame_num] = changed;
+    status->changed[(cur_frame_num + 1) % CHUNK_FRAMES] = true;
+}
+
+//the text file has width + 1 bytes in every row (the last one can be without the newline),
+//so the place of every chunk in it is known
+
+static inline off_t
+text_file_offset(Board *board, unsigned x, unsigned y)
+{
+    return (off_t) y * (board->width + 1) + x;
+}
+
+//INSTRUCTION_SAVE_TEXT: the rows of the chunk are written to their places in the file
+static bool
+chunk_save_text(Board *board, Frame *frame, unsigned chunk_num_x, unsigned chunk_num_y)
+{
+    int fd = open(board->cur_instruction->path, O_WRONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    //the newlines are written by the last column of the chunks
+    bool last_col = chunk_num_x == board->chunks_hor_count - 1;
+    size_t size = frame->width + (last_col ? 1 : 0);
+    char *buffer = calloc(frame->width + 1, sizeof(*buffer));
+    buffer[frame->width] = '\n';
+
+    bool result = true;
+    for (unsigned j = 1; j <= frame->height && result; j++) {
+        char *line = frame_render_line(frame, j);
+        memcpy(buffer, line, frame->width);
+        free(line);
+
+        off_t offset = text_file_offset(
+            board,
+            board->col_starts[chunk_num_x],
+            board->row_starts[chunk_num_y] + j - 1);
+        result = pwrite(fd, buffer, size, offset) == (ssize_t) size;
+    }
+
+    free(buffer);
+    close(fd);
+    return result;
+}
+
+//INSTRUCTION_LOAD_TEXT: the rows of the chunk are read to Board.cells,
+//the cells are imported only if all of the chunks are read successfully
+static bool
+chunk_load_text(Board *board, unsigned width, unsigned height, unsigned chunk_num_x, unsigned chunk_num_y)
+{
+    int fd = open(board->cur_instruction->path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    bool last_col = chunk_num_x == board->chunks_hor_count - 1;
+    size_t size = width + (last_col ? 1 : 0);
+    char *buffer = calloc(width + 1, sizeof(*buffer));
+
+    bool result = true;
+    for (unsigned j = 0; j < height && result; j++) {
+        unsigned x = board->col_starts[chunk_num_x];
+        unsigned y = board->row_starts[chunk_num_y] + j;
+        ssize_t done = pread(fd, buffer, size, text_file_offset(board, x, y));
+
+        //the last row can be without the newline
+        result = done == (ssize_t) size ||
+            (last_col && y == board->height - 1 && done == (ssize_t) width);
+        if (result && last_col && done == (ssize_t) size) {
+            result = buffer[width] == '\n';
+        }
+
+        //the rows of the text format are shorter, if they have the newlines or zeros
+        unsigned char *row = board->cells + (size_t) y * board->row_size;
+        for (unsigned i = 0; i < width && result; i += CELL_WORD_BITS) {
+            unsigned count = width - i < CELL_WORD_BITS ? width - i : CELL_WORD_BITS;
+            Cell_word value = 0;
+            for (unsigned k = 0; k < count && result; k++) {
+                result = buffer[i + k] != '\n' && buffer[i + k] != '\0';
+                value |= (Cell_word) (buffer[i + k] == '*') << k;
+            }
+            bits_write(row, (size_t) x + i, count, value);
+        }
+    }
+
+    free(buffer);
+    close(fd);
+    return result;
+}
+
+//the instruction for one chunk, except INSTRUCTION_DESTROY
+//(and INSTRUCTION_STEP and INSTRUCTION_RUN, if the chunks are calculated by the pool)
+static void
+chunk_execute(
+    Board *board,
+    unsigned chunk_num_x,
+    unsigned chunk_num_y,
+    Worker_neighbours *neighbours,
+    unsigned *progress,
+    unsigned long long *turns)
+{
+    unsigned width = chunk_width(board, chunk_num_x);
+    unsigned height = chunk_height(board, chunk_num_y);
+
+    Chunk_segments *cur_segments = board->segments[chunk_num_y][chunk_num_x];
+    Chunk *chunk = cur_segments->chunk;
+    Chunk_status *status = cur_segments->status;
+    char *special_pointer = cur_segments->special;
+
+    //the part of the whole board for the export and the import
+    unsigned chunk_offset = board->col_starts[chunk_num_x];
+    unsigned char *chunk_cells = board->cells + (size_t) board->row_starts[chunk_num_y] * board->row_size;
+
+    Instruction *instruction = board->cur_instruction;
+    Frame *cur_frame = chunk->cur_frame;
+    char *scanline;
+    switch (instruction->id) {
+        case INSTRUCTION_ADD_CELL:
+            frame_set_cell(cur_frame, instruction->param1, instruction->param2, CELL_ALIVE);
+            chunk_history_clear(status);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            break;
+        case INSTRUCTION_WRITE_SCANLINE:
+            scanline = frame_render_line(cur_frame, instruction->param1);
+            memcpy(special_pointer, scanline, width);
+            free(scanline);
+            break;
+        case INSTRUCTION_READ_SCANLINE:
+            scanline = calloc(width + 1, sizeof(*scanline));
+            memcpy(scanline, special_pointer, width);
+            frame_load_line(cur_frame, scanline, instruction->param1);
+            chunk_history_clear(status);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            free(scanline);
+            break;
+        case INSTRUCTION_UPDATE_INNER_BORDERS:
+            //the neighbours read the cells of the frame directly
+            break;
+        case INSTRUCTION_UPDATE_OUTER_BORDERS:
+            frame_update_outer_borders(cur_frame);
+            break;
+        case INSTRUCTION_CALCULATE:
+            frame_calc(chunk_switch_next_frame(chunk), cur_frame);
+            break;
+        case INSTRUCTION_STEP:
+            //the neighbours publish the borders of the next frame into
+            //the other halves, so nobody waits for anybody inside of the step
+            chunk_turn(chunk, status, neighbours->statuses, neighbours->count, turns);
+            break;
+        case INSTRUCTION_RUN:
+            if (board->halo_depth > 1) {
+                chunk_run_deep(board, chunk, status, neighbours, progress, turns, instruction->param1);
+            } else {
+                chunk_run(chunk, status, neighbours, progress, turns, instruction->param1);
+            }
+            break;
+        case INSTRUCTION_CLEAR:
+            chunk_clear(chunk);
+            chunk_history_clear(status);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            break;
+        case INSTRUCTION_EXPORT:
+            frame_export(cur_frame, chunk_cells, board->row_size, chunk_offset);
+            break;
+        case INSTRUCTION_IMPORT:
+            frame_import(cur_frame, chunk_cells, board->row_size, chunk_offset);
+            chunk_history_clear(status);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            break;
+        case INSTRUCTION_UNDO:
+            chunk_history_undo(chunk, status, instruction->param1);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            break;
+        case INSTRUCTION_REDO:
+            chunk_history_redo(chunk, status, instruction->param1);
+            status->changed[chunk->cur_frame_num] = true;
+            worker_record_hash(chunk, status, *turns);
+            break;
+        case INSTRUCTION_CLEAR_HISTORY:
+            chunk_history_clear(status);
+            break;
+        case INSTRUCTION_SAVE_TEXT:
+            status->file_failed = !chunk_save_text(board, cur_frame, chunk_num_x, chunk_num_y);
+            break;
+        case INSTRUCTION_LOAD_TEXT:
+            status->file_failed = !chunk_load_text(board, width, height, chunk_num_x, chunk_num_y);
+            break;
+        case INSTRUCTION_DESTROY:
+        case INSTRUCTION_NOP:
+        default:
+            break;
+    }
+}
+
+//with several chunks per worker INSTRUCTION_STEP and INSTRUCTION_RUN are made by the pool
+//of the workers in the rounds: every chunk of the round is processed once by any worker,
+//the rounds are separated by the barrier of the workers, so the chunks of the round
+//are independent: they read the borders of the frames, which nobody writes in this round
+typedef enum Pool_task
+{
+    POOL_TURN, //the generation
+    POOL_BORDERS, //reads the borders of the block of the deep halo
+    POOL_BLOCK //calculates the turns of the block
+} Pool_task;
+
+//the turns of the block of the deep halo, the borders are already read in the previous round
+static void
+chunk_block(Chunk *chunk, Chunk_status *status, unsigned long long turns, unsigned block_turns)
+{
+    bool changed = false;
+    for (unsigned k = 1; k <= block_turns; k++) {
+        if (status->block_active) {
+            changed = chunk_do_deep_turn(chunk, block_turns - k);
+        } else {
+            //the skipped turns change only the halo, which the neighbours don't read
+            chunk_skip_turn(chunk);
+        }
+        worker_record_turn(chunk, status, &turns, changed);
+    }
+    if (!status->block_active) {
+        status->skipped_count += block_turns;
+    }
+
+    //the previous frame is unknown after the block
+    unsigned cur_frame_num = chunk->cur_frame_num;
+    status->changed[cur_frame_num] = changed;
+    status->changed[(cur_frame_num + 1) % CHUNK_FRAMES] = true;
+}
+
+//the task on the chunk (by the number in the order of the rows) after the given turns,
+//returns the turns of the chunk, which are calculated (not skipped)
+static unsigned
+pool_chunk_task(Board *board, Pool_task task, unsigned chunk_num, unsigned long long turns, unsigned block_turns)
+{
+    unsigned chunk_num_x = chunk_num % board->chunks_hor_count;
+    unsigned chunk_num_y = chunk_num / board->chunks_hor_count;
+    Chunk_segments *segments = board->segments[chunk_num_y][chunk_num_x];
+    Chunk *chunk = segments->chunk;
+    Chunk_status *status = segments->status;
+
+    Worker_neighbours neighbours;
+    worker_neighbours_init(board, chunk_num_x, chunk_num_y, 0, &neighbours);
+
+    switch (task) {
+        case POOL_TURN:
+            return chunk_turn(chunk, status, neighbours.statuses, neighbours.count, &turns) ? 1 : 0;
+        case POOL_BORDERS:
+            status->block_active = chunk_active(status, neighbours.statuses, neighbours.count, chunk->cur_frame_num);
+            if (status->block_active) {
+                frame_update_outer_borders(chunk->cur_frame);
+            }
+            return 0;
+        case POOL_BLOCK:
+        default:
+            chunk_block(chunk, status, turns, block_turns);
+            return status->block_active ? block_turns : 0;
+    }
+}
+
+//the worker takes the chunks of the round from its deque, then steals them from the others,
+//when there is nothing to take, the worker fills its deque for the next round:
+//the others don't take them, until they finish this round (see worker_deque_take)
+static void
+worker_pool_round(
+    Board *board,
+    unsigned worker_num,
+    unsigned *round,
+    unsigned *pool_sense,
+    Pool_task task,
+    unsigned long long turns,
+    unsigned block_turns)
+{
+    unsigned chunks_per_worker = board->chunks_per_worker;
+    Worker_status *status = board->workers_statuses[worker_num];
+
+    unsigned chunk_pos;
+    while (worker_deque_take(status, *round, true, &chunk_pos)) {
+        unsigned chunk_num = worker_num * chunks_per_worker + chunk_pos;
+        status->chunk_turns += pool_chunk_task(board, task, chunk_num, turns, block_turns);
+    }
+
+    for (unsigned k = 1; k < board->workers_count; k++) {
+        unsigned victim = (worker_num + k) % board->workers_count;
+        while (worker_deque_take(board->workers_statuses[victim], *round, false, &chunk_pos)) {
+            unsigned chunk_num = victim * chunks_per_worker + chunk_pos;
+            unsigned chunk_turns = pool_chunk_task(board, task, chunk_num, turns, block_turns);
+            status->chunk_turns += chunk_turns;
+            status->stolen_turns += chunk_turns;
+        }
+    }
+
+    (*round)++;
+    worker_deque_reset(board, worker_num, *round);
+    unsigned long long start = clock_ns();
+    barrier_wait(board->pool_barrier, pool_sense);
+    status->wait_ns += clock_ns() - start;
+}
+
+//the generations by the pool: a round for every generation, or two rounds for every block
+//of the deep halo (the borders are read before any chunk of the block writes its frames)
+static void
+worker_pool_run(
+    Board *board,
+    unsigned worker_num,
+    unsigned *round,
+    unsigned *pool_sense,
+    unsigned long long *turns,
+    unsigned generations,
+    unsigned depth)
+{
+    unsigned done = 0;
+    while (done < generations) {
+        if (depth > 1) {
+            unsigned block_turns = generations - done < depth ? generations - done : depth;
+            worker_pool_round(board, worker_num, round, pool_sense, POOL_BORDERS, *turns, block_turns);
+            worker_pool_round(board, worker_num, round, pool_sense, POOL_BLOCK, *turns, block_turns);
+            *turns += block_turns;
+            done += block_turns;
+        } else {
+            worker_pool_round(board, worker_num, round, pool_sense, POOL_TURN, *turns, 1);
+            (*turns)++;
+            done++;
+        }
+    }
+}
+
+//main loop of the worker of its chunks, returns after INSTRUCTION_DESTROY
+static void
+board_worker(Board *board, unsigned worker_num)
+{
+    //before the worker touches its chunks
+    if (board->affinity != BOARD_AFFINITY_NONE) {
+        affinity_pin(
+            board->cpus,
+            board->cpus_count,
+            worker_num % board->cpus_count,
+            board->affinity == BOARD_AFFINITY_NODES);
+    }
+
+    unsigned chunks_per_worker = board->chunks_per_worker;
+    unsigned frst_chunk = worker_num * chunks_per_worker;
+    Worker_status *worker_status = board->workers_statuses[worker_num];
+
+    Worker_neighbours *neighbours = calloc(chunks_per_worker, sizeof(*neighbours));
+    unsigned spin_count = barrier_spin_count(board->workers_count);
+    for (unsigned k = 0; k < chunks_per_worker; k++) {
+        unsigned chunk_num = frst_chunk + k;
+        worker_neighbours_init(
+            board,
+            chunk_num % board->chunks_hor_count,
+            chunk_num / board->chunks_hor_count,
+            spin_count,
+            &neighbours[k]);
+    }
+
+    Instruction *instruction = board->cur_instruction;
+    unsigned barrier_sense = 0;
+    unsigned pool_sense = 0;
+    unsigned round = 0;
+    unsigned progress = 0;
+    //the workers of the rebalanced board continue the turns of the master
+    unsigned long long turns = board->turns_count;
+    bool terminate = false;
+    do {
+        worker_wait_instruction(board, &barrier_sense);
+
+        bool turns_made = instruction->id == INSTRUCTION_STEP || instruction->id == INSTRUCTION_RUN;
+        bool pooled = chunks_per_worker > 1 && turns_made;
+        unsigned long long start = turns_made ? clock_ns() : 0;
+        unsigned long long prev_wait_ns = worker_status->wait_ns;
+        if (instruction->id == INSTRUCTION_DESTROY) {
+            terminate = true;
+        } else if (pooled) {
+            bool step = instruction->id == INSTRUCTION_STEP;
+            worker_pool_run(
+                board,
+                worker_num,
+                &round,
+                &pool_sense,
+                &turns,
+                step ? 1 : instruction->param1,
+                step ? 1 : board->halo_depth);
+        } else {
+            for (unsigned k = 0; k < chunks_per_worker; k++) {
+                unsigned chunk_num_x = (frst_chunk + k) % board->chunks_hor_count;
+                unsigned chunk_num_y = (frst_chunk + k) / board->chunks_hor_count;
+                if ((instruction->chunk_num_x == chunk_num_x ||
+                    instruction->chunk_num_x == CHUNK_NUM_ANY) &&
+                    (instruction->chunk_num_y == chunk_num_y ||
+                    instruction->chunk_num_y == CHUNK_NUM_ANY)) {
+                    //the turns are made here only by the worker of one chunk
+                    Chunk_status *status = board->segments[chunk_num_y][chunk_num_x]->status;
+                    unsigned long long prev_turns = turns;
+                    unsigned long long prev_skipped = status->skipped_count;
+                    chunk_execute(board, chunk_num_x, chunk_num_y, &neighbours[k], &progress, &turns);
+                    worker_status->chunk_turns += turns - prev_turns - (status->skipped_count - prev_skipped);
+                    worker_status->wait_ns += neighbours[k].wait_ns;
+                    neighbours[k].wait_ns = 0;
+                }
+            }
+        }
+        if (turns_made) {
+            worker_status->busy_ns += clock_ns() - start - (worker_status->wait_ns - prev_wait_ns);
+        }
+
+        worker_finish_instruction(board, &barrier_sense);
+    } while (!terminate);
+
+    free(neighbours);
+}
+
+typedef struct Worker_args
+{
+    Board *board;
+    unsigned worker_num;
+} Worker_args;
+
+static void *
+worker_thread(void *data)
+{
+    Worker_args *args = data;
+    board_worker(args->board, args->worker_num);
+    free(args);
+    return NULL;
+}
+
+static void
+board_workers_create(Board *board)
+{
+    for (unsigned k = 0; k < board->workers_count; k++) {
+        if (board->backend == BOARD_BACKEND_THREADS) {
+            Worker_args *args = calloc(1, sizeof(*args));
+            args->board = board;
+            args->worker_num = k;
+            pthread_create(&board->threads[k], NULL, worker_thread, args);
+        } else if (!(board->workers[k] = fork())) {
+            board_worker(board, k);
+            exit(0);
+        }
+    }
+}
+
+static void
+board_send_instruction(Board *board)
+{
+    if (board->sync == BOARD_SYNC_FUTEX) {
+        barrier_wait(board->barrier, &board->barrier_sense);
+        barrier_wait(board->barrier, &board->barrier_sense);
+        return;
+    }
+
+    struct sembuf *operation = calloc(1, sizeof(*operation));
+    operation->sem_num = 0;
+    operation->sem_op = board->workers_count;
+    semop(board->sem_id, operation, 1);
+    operation->sem_num = 1;
+    operation->sem_op = -board->workers_count;
+    semop(board->sem_id, operation, 1);
+    free(operation);
+}
+
+//the chunk with the coordinate (from one) by the starts of the chunks
+static inline unsigned
+get_chunk_num(unsigned coord, const unsigned *starts, unsigned chunk_count)
+{
+    unsigned frst = 0;
+    unsigned last = chunk_count - 1;
+    while (frst < last) {
+        unsigned middle = (frst + last + 1) / 2;
+        if (starts[middle] < coord) {
+            frst = middle;
+        } else {
+            last = middle - 1;
+        }
+    }
+    return frst;
+}
+
+static inline unsigned
+get_chunk_coord(unsigned coord, const unsigned *starts, unsigned chunk_count)
+{
+    return coord - starts[get_chunk_num(coord, starts, chunk_count)];
+}
+
+//hash of the whole board after the turn, which is still in the history of the workers
+static uint64_t
+board_turn_hash(Board *board, unsigned long long turn)
+{
+    uint64_t result = 0;
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            Chunk_status *status = board->segments[j][i]->status;
+            result = (result + status->hashes[turn % BOARD_HISTORY_LENGTH]) * 0x9E3779B97F4A7C15ULL;
+        }
+    }
+    return result;
+}
+
+//the still life is detected exactly by the change flags of the last turn,
+//the oscillators by the hashes of the generations, which are a period apart
+static void
+board_detect_period(Board *board)
+{
+    unsigned long long turn = board->turns_count;
+    board->period = 0;
+    if (board->max_period == 0 || turn == board->history_start) {
+        return;
+    }
+
+    bool changed = false;
+    for (unsigned j = 0; j < board->chunks_ver_count && !changed; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count && !changed; i++) {
+            changed = board->segments[j][i]->status->turn_changed[turn % BOARD_HISTORY_LENGTH];
+        }
+    }
+    if (!changed) {
+        board->period = 1;
+        return;
+    }
+
+    uint64_t hash = board_turn_hash(board, turn);
+    for (unsigned period = 2; period <= board->max_period && period <= turn - board->history_start; period++) {
+        if (board_turn_hash(board, turn - period) == hash) {
+            board->period = period;
+            return;
+        }
+    }
+}
+
+//the cells are changed not by the turn, so the older generations can't be compared
+static inline void
+board_reset_history(Board *board)
+{
+    board->history_start = board->turns_count;
+    board->period = 0;
+}
+
+bool
+board_add_cell(Board *board, unsigned x, unsigned y)
+{
+    if (x < 1 || x > board->width || y < 1|| y > board->height) {
+        return false;
+    }
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        return hashlife_set_cell(board->hashlife, x, y, CELL_ALIVE);
+    }
+
+    Instruction *instruction = board->cur_instruction;
+    instruction->id = INSTRUCTION_ADD_CELL;
+    instruction->chunk_num_x = get_chunk_num(x, board->col_starts, board->chunks_hor_count);
+    instruction->chunk_num_y = get_chunk_num(y, board->row_starts, board->chunks_ver_count);
+    instruction->param1 = get_chunk_coord(x, board->col_starts, board->chunks_hor_count);
+    instruction->param2 = get_chunk_coord(y, board->row_starts, board->chunks_ver_count);
+    board_send_instruction(board);
 
+    board_reset_history(board);
     return true;
 }
 
+//the estimated work of the cell for the rebalancing: a live cell costs as much as this count
+//of the dead ones, the stable chunks are skipped and only the changed tiles are calculated
+enum
+{
+    REBALANCE_LIVE_CELL_COST = 8
+};
+
+//the live cells of every column and row of the exported board
+static void
+count_live_cells(Board *board, const unsigned char *cells, unsigned *col_counts, unsigned *row_counts)
+{
+    for (unsigned y = 0; y < board->height; y++) {
+        const unsigned char *row = cells + (size_t) y * board->row_size;
+        for (unsigned byte = 0; byte < board->row_size; byte++) {
+            for (unsigned bits = row[byte]; bits != 0; bits &= bits - 1) {
+                unsigned x = byte * 8 + __builtin_ctz(bits);
+                if (x < board->width) {
+                    col_counts[x] += 1;
+                    row_counts[y] += 1;
+                }
+            }
+        }
+    }
+}
+
+//the largest estimated work of the chunk with these starts
+static double
+partition_max_work(Board *board, const unsigned char *cells, const unsigned *col_starts, const unsigned *row_starts)
+{
+    unsigned chunks_hor = board->chunks_hor_count;
+    unsigned chunks_ver = board->chunks_ver_count;
+    unsigned long long *live_counts = calloc(board->chunks_count, sizeof(*live_counts));
+    for (unsigned y = 0; y < board->height; y++) {
+        const unsigned char *row = cells + (size_t) y * board->row_size;
+        unsigned chunk_num_y = get_chunk_num(y + 1, row_starts, chunks_ver);
+        for (unsigned byte = 0; byte < board->row_size; byte++) {
+            for (unsigned bits = row[byte]; bits != 0; bits &= bits - 1) {
+                unsigned x = byte * 8 + __builtin_ctz(bits);
+                if (x < board->width) {
+                    live_counts[chunk_num_y * chunks_hor + get_chunk_num(x + 1, col_starts, chunks_hor)] += 1;
+                }
+            }
+        }
+    }
+
+    double result = 0;
+    for (unsigned j = 0; j < chunks_ver; j++) {
+        for (unsigned i = 0; i < chunks_hor; i++) {
+            double work =
+                (double) (col_starts[i + 1] - col_starts[i]) * (row_starts[j + 1] - row_starts[j]) +
+                (double) live_counts[j * chunks_hor + i] * REBALANCE_LIVE_CELL_COST;
+            if (work > result) {
+                result = work;
+            }
+        }
+    }
+    free(live_counts);
+    return result;
+}
+
+//the frames can't be moved in the arena, so the chunks and the workers are created again
+//with the new starts, the cells and the counters of the old ones are copied to them
+static void
+board_move_chunks(Board *board, const unsigned char *cells, unsigned *col_starts, unsigned *row_starts)
+{
+    size_t cells_size = (size_t) board->row_size * board->height;
+    unsigned char *saved_cells = malloc(cells_size);
+    memcpy(saved_cells, cells, cells_size);
+
+    unsigned long long *skipped_counts = calloc(board->chunks_count, sizeof(*skipped_counts));
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            skipped_counts[j * board->chunks_hor_count + i] = board->segments[j][i]->status->skipped_count;
+        }
+    }
+    unsigned long long *chunk_turns = calloc(board->workers_count, sizeof(*chunk_turns));
+    unsigned long long *stolen_turns = calloc(board->workers_count, sizeof(*stolen_turns));
+    unsigned long long *busy_ns = calloc(board->workers_count, sizeof(*busy_ns));
+    unsigned long long *wait_ns = calloc(board->workers_count, sizeof(*wait_ns));
+    for (unsigned k = 0; k < board->workers_count; k++) {
+        chunk_turns[k] = board->workers_statuses[k]->chunk_turns;
+        stolen_turns[k] = board->workers_statuses[k]->stolen_turns;
+        busy_ns[k] = board->workers_statuses[k]->busy_ns;
+        wait_ns[k] = board->workers_statuses[k]->wait_ns;
+    }
+
+    board_chunks_destroy(board);
+    unsigned *old_col_starts = board->col_starts;
+    unsigned *old_row_starts = board->row_starts;
+    board->col_starts = col_starts;
+    board->row_starts = row_starts;
+    if (board_chunks_create(board)) {
+        free(old_col_starts);
+        free(old_row_starts);
+    } else {
+        //the memory of the old chunks is just freed, so they fit in it again
+        board->col_starts = old_col_starts;
+        board->row_starts = old_row_starts;
+        free(col_starts);
+        free(row_starts);
+        board_chunks_create(board);
+    }
+
+    //the workers wait for the instruction, so the counters can be written
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            board->segments[j][i]->status->skipped_count = skipped_counts[j * board->chunks_hor_count + i];
+        }
+    }
+    for (unsigned k = 0; k < board->workers_count; k++) {
+        board->workers_statuses[k]->chunk_turns = chunk_turns[k];
+        board->workers_statuses[k]->stolen_turns = stolen_turns[k];
+        board->workers_statuses[k]->busy_ns = busy_ns[k];
+        board->workers_statuses[k]->wait_ns = wait_ns[k];
+    }
+    board_import(board, saved_cells);
+
+    free(saved_cells);
+    free(skipped_counts);
+    free(chunk_turns);
+    free(stolen_turns);
+    free(busy_ns);
+    free(wait_ns);
+}
+
+//the numbers of the columns and the rows of the chunks stay, their sizes are selected
+//by partition_line with the weights of the cells of the whole columns and rows
+bool
+board_rebalance(Board *board)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE || board->chunks_count == 1) {
+        return false;
+    }
+
+    unsigned width = board->width;
+    unsigned height = board->height;
+    unsigned chunks_hor = board->chunks_hor_count;
+    unsigned chunks_ver = board->chunks_ver_count;
+    const unsigned char *cells = board_export(board);
+
+    unsigned *col_counts = calloc(width, sizeof(*col_counts));
+    unsigned *row_counts = calloc(height, sizeof(*row_counts));
+    count_live_cells(board, cells, col_counts, row_counts);
+
+    double *col_weights = calloc(width, sizeof(*col_weights));
+    double *row_weights = calloc(height, sizeof(*row_weights));
+    for (unsigned i = 0; i < width; i++) {
+        col_weights[i] = height + (double) col_counts[i] * REBALANCE_LIVE_CELL_COST;
+    }
+    for (unsigned j = 0; j < height; j++) {
+        row_weights[j] = width + (double) row_counts[j] * REBALANCE_LIVE_CELL_COST;
+    }
+
+    //the sides are the dead cells of the whole column or row
+    double side_cost = partition_side_cost(board->max_halo_depth);
+    unsigned max_halo_depth = board->max_halo_depth;
+    unsigned min_width = width / chunks_hor < max_halo_depth ? width / chunks_hor : max_halo_depth;
+    unsigned min_height = height / chunks_ver < max_halo_depth ? height / chunks_ver : max_halo_depth;
+    unsigned *col_starts = calloc(chunks_hor + 1, sizeof(*col_starts));
+    unsigned *row_starts = calloc(chunks_ver + 1, sizeof(*row_starts));
+    partition_line(col_weights, width, chunks_hor, side_cost * height, min_width, col_starts);
+    partition_line(row_weights, height, chunks_ver, side_cost * width, min_height, row_starts);
+
+    double cur_work = partition_max_work(board, cells, board->col_starts, board->row_starts);
+    double new_work = partition_max_work(board, cells, col_starts, row_starts);
+    bool moved = cur_work > new_work * (1 + board->rebalance_threshold / 100.0);
+    if (moved) {
+        board_move_chunks(board, cells, col_starts, row_starts);
+        board->rebalances_count += 1;
+    } else {
+        free(col_starts);
+        free(row_starts);
+    }
+
+    free(col_counts);
+    free(row_counts);
+    free(col_weights);
+    free(row_weights);
+    return moved;
+}
+
+//once in rebalance_interval turns, the oscillating board keeps its chunks and the history
+static void
+board_check_balance(Board *board)
+{
+    if (board->rebalance_interval == 0 || board->period != 0 ||
+        board->turns_count - board->balance_turn < board->rebalance_interval) {
+        return;
+    }
+    board->balance_turn = board->turns_count;
+    board_rebalance(board);
+}
+
 void
 board_next_turn(Board *board)
 {
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        board_run(board, 1);
+        return;
+    }
+
+    board_check_balance(board);
+
     Instruction *instruction = board->cur_instruction;
     instruction->chunk_num_x = CHUNK_NUM_ANY;
     instruction->chunk_num_y = CHUNK_NUM_ANY;
-    instruction->id = INSTRUCTION_UPDATE_INNER_BORDERS;
-    board_send_instruction(board);
-    instruction->id = INSTRUCTION_UPDATE_OUTER_BORDERS;
+    instruction->id = INSTRUCTION_STEP;
     board_send_instruction(board);
-    instruction->id = INSTRUCTION_CALCULATE;
+
+    board->generation_num += 1;
+    board->turns_count += 1;
+    board_detect_period(board);
+}
+
+bool
+board_run(Board *board, unsigned long long generations)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        unsigned long long done = hashlife_run(board->hashlife, generations);
+        board->generation_num += done;
+        return done == generations;
+    }
+
+    while (generations > 0) {
+        //the run is split by the checks of the balance
+        board_check_balance(board);
+        unsigned long long max_generations = UINT_MAX;
+        unsigned long long balance_end = board->balance_turn + board->rebalance_interval;
+        if (board->rebalance_interval != 0 && balance_end > board->turns_count &&
+            balance_end - board->turns_count < max_generations) {
+            max_generations = balance_end - board->turns_count;
+        }
+        unsigned cur_generations = generations > max_generations ? max_generations : generations;
+
+        //the chunks are created again by the rebalancing
+        Instruction *instruction = board->cur_instruction;
+        instruction->id = INSTRUCTION_RUN;
+        instruction->chunk_num_x = CHUNK_NUM_ANY;
+        instruction->chunk_num_y = CHUNK_NUM_ANY;
+        instruction->param1 = cur_generations;
+        board_send_instruction(board);
+
+        board->generation_num += cur_generations;
+        board->turns_count += cur_generations;
+        generations -= cur_generations;
+    }
+    board_detect_period(board);
+    return true;
+}
+
+//the oscillator is found by the hashes only, so before the skip the board is calculated
+//for one more period and compared with its cells before it (the still life is exact)
+static bool
+board_confirm_period(Board *board, unsigned period)
+{
+    size_t size = board->row_size * board->height;
+    unsigned char *before = malloc(size);
+    memcpy(before, board_export(board), size);
+    board_run(board, period);
+    bool result = memcmp(before, board_export(board), size) == 0;
+    free(before);
+    return result;
+}
+
+bool
+board_fast_forward(Board *board, unsigned long long generations)
+{
+    unsigned period = board_get_period(board);
+    if (period == 0 || generations < period) {
+        return board_run(board, generations);
+    }
+    if (period > 1) {
+        bool confirmed = board_confirm_period(board, period);
+        generations -= period;
+        if (!confirmed) {
+            //the collision of the hashes
+            board->period = 0;
+            return board_run(board, generations);
+        }
+    }
+
+    //the state after the whole periods is the same, but the records of the history
+    //before the skip would undo to the generations, which weren't calculated
+    unsigned long long rest = generations % period;
+    if (generations - rest > 0) {
+        Instruction *instruction = board->cur_instruction;
+        instruction->id = INSTRUCTION_CLEAR_HISTORY;
+        instruction->chunk_num_x = CHUNK_NUM_ANY;
+        instruction->chunk_num_y = CHUNK_NUM_ANY;
+        board_send_instruction(board);
+
+        board->generation_num += generations - rest;
+        board_reset_history(board);
+    }
+    return board_run(board, rest);
+}
+
+//the least of the counts of the records of the chunks
+static unsigned
+board_history_depth(Board *board, bool redo)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        return 0;
+    }
+
+    unsigned result = UINT_MAX;
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            Chunk_status *status = board->segments[j][i]->status;
+            unsigned count = redo ? status->history_redo_count : status->history_count;
+            if (count < result) {
+                result = count;
+            }
+        }
+    }
+    return result;
+}
+
+unsigned
+board_get_undo_depth(Board *board)
+{
+    return board_history_depth(board, false);
+}
+
+unsigned
+board_get_redo_depth(Board *board)
+{
+    return board_history_depth(board, true);
+}
+
+static bool
+board_move_in_history(Board *board, unsigned generations, bool redo)
+{
+    if (generations > board_history_depth(board, redo)) {
+        return false;
+    }
+    if (generations == 0) {
+        return true;
+    }
+
+    Instruction *instruction = board->cur_instruction;
+    instruction->id = redo ? INSTRUCTION_REDO : INSTRUCTION_UNDO;
+    instruction->chunk_num_x = CHUNK_NUM_ANY;
+    instruction->chunk_num_y = CHUNK_NUM_ANY;
+    instruction->param1 = generations;
     board_send_instruction(board);
 
-    board->generation_num += 1;
+    if (redo) {
+        board->generation_num += generations;
+    } else {
+        board->generation_num -= generations;
+    }
+    board_reset_history(board);
+    return true;
+}
+
+bool
+board_undo(Board *board, unsigned generations)
+{
+    return board_move_in_history(board, generations, false);
+}
+
+bool
+board_redo(Board *board, unsigned generations)
+{
+    return board_move_in_history(board, generations, true);
 }
 
 void
 board_clear(Board *board)
 {
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        hashlife_clear(board->hashlife);
+        board->generation_num = 1;
+        return;
+    }
+
     Instruction *instruction = board->cur_instruction;
     instruction->id = INSTRUCTION_CLEAR;
     instruction->chunk_num_x = CHUNK_NUM_ANY;
     instruction->chunk_num_y = CHUNK_NUM_ANY;
     board_send_instruction(board);
 
+    board_reset_history(board);
     board->generation_num = 1;
 }
 
@@ -487,20 +1971,23 @@ board_get_scanline(Board *board, unsigned y)
     if (y < 1 || y > board->height) {
         return NULL;
     }
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        return hashlife_render_line(board->hashlife, y);
+    }
+
     Instruction *instruction = board->cur_instruction;
     instruction->id = INSTRUCTION_WRITE_SCANLINE;
     instruction->chunk_num_x = CHUNK_NUM_ANY;
-    instruction->chunk_num_y = get_chunk_num(y, board->chunk_size, board->chunks_ver_count);
-    instruction->param1 = get_chunk_coord(y, board->chunk_size, board->chunks_ver_count);
+    instruction->chunk_num_y = get_chunk_num(y, board->row_starts, board->chunks_ver_count);
+    instruction->param1 = get_chunk_coord(y, board->row_starts, board->chunks_ver_count);
     board_send_instruction(board);
 
     char *result = calloc(board->width + 1, sizeof(*result));
-    unsigned last_chunk_num = board->chunks_hor_count - 1;
     for (unsigned i = 0; i < board->chunks_hor_count; i++) {
         memcpy(
-            result + i * board->chunk_size,
-            board->special_pointers[instruction->chunk_num_y][i],
-            (i == last_chunk_num ? board->last_width : board->chunk_size) * sizeof(char));
+            result + board->col_starts[i],
+            board->segments[instruction->chunk_num_y][i]->special,
+            chunk_width(board, i) * sizeof(char));
     }
 
     return result;
@@ -515,124 +2002,622 @@ board_set_scanline(Board *board, unsigned y, char *scanline)
     if (strlen(scanline) != board->width) {
         return false;
     }
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        return hashlife_load_line(board->hashlife, scanline, y);
+    }
 
-    unsigned chunk_num = get_chunk_num(y, board->chunk_size, board->chunks_ver_count);
-    unsigned last_chunk_num = board->chunks_hor_count - 1;
+    unsigned chunk_num = get_chunk_num(y, board->row_starts, board->chunks_ver_count);
     for (unsigned i = 0; i < board->chunks_hor_count; i++) {
         memcpy(
-            board->special_pointers[chunk_num][i],
-            scanline + i * board->chunk_size,
-            (i == last_chunk_num ? board->last_width : board->chunk_size) * sizeof(char));
+            board->segments[chunk_num][i]->special,
+            scanline + board->col_starts[i],
+            chunk_width(board, i) * sizeof(char));
     }
 
     Instruction *instruction = board->cur_instruction;
     instruction->id = INSTRUCTION_READ_SCANLINE;
     instruction->chunk_num_x = CHUNK_NUM_ANY;
     instruction->chunk_num_y = chunk_num;
-    instruction->param1 = get_chunk_coord(y, board->chunk_size, board->chunks_ver_count);
+    instruction->param1 = get_chunk_coord(y, board->row_starts, board->chunks_ver_count);
     board_send_instruction(board);
+
+    board_reset_history(board);
     return true;
 }
 
+char *
+board_unpack_scanline(Board *board, const unsigned char *cells, unsigned y)
+{
+    if (y < 1 || y > board->height) {
+        return NULL;
+    }
+
+    const unsigned char *row = cells + (size_t) (y - 1) * board->row_size;
+    char *result = calloc(board->width + 1, sizeof(*result));
+    for (unsigned i = 0; i < board->width; i++) {
+        result[i] = (row[i / 8] >> (i % 8)) & 1 ? '*' : '.';
+    }
+    return result;
+}
+
 bool
-board_load_from_file(Board *board, FILE *input)
+board_pack_scanline(Board *board, unsigned char *cells, unsigned y, const char *scanline)
 {
-    if (input == NULL) {
+    if (y < 1 || y > board->height) {
+        return false;
+    }
+    if (strlen(scanline) != board->width) {
+        return false;
+    }
+
+    unsigned char *row = cells + (size_t) (y - 1) * board->row_size;
+    memset(row, 0, board->row_size);
+    for (unsigned i = 0; i < board->width; i++) {
+        if (scanline[i] == '*') {
+            row[i / 8] |= 1 << (i % 8);
+        }
+    }
+    return true;
+}
+
+unsigned char *
+board_export(Board *board)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        for (unsigned j = 1; j <= board->height; j++) {
+            char *scanline = hashlife_render_line(board->hashlife, j);
+            board_pack_scanline(board, board->cells, j, scanline);
+            free(scanline);
+        }
+        return board->cells;
+    }
+
+    Instruction *instruction = board->cur_instruction;
+    instruction->id = INSTRUCTION_EXPORT;
+    instruction->chunk_num_x = CHUNK_NUM_ANY;
+    instruction->chunk_num_y = CHUNK_NUM_ANY;
+    board_send_instruction(board);
+    return board->cells;
+}
+
+bool
+board_import(Board *board, const unsigned char *cells)
+{
+    if (cells != board->cells) {
+        memcpy(board->cells, cells, board->row_size * board->height);
+    }
+
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        bool result = true;
+        for (unsigned j = 1; j <= board->height && result; j++) {
+            char *scanline = board_unpack_scanline(board, board->cells, j);
+            result = hashlife_load_line(board->hashlife, scanline, j);
+            free(scanline);
+        }
+        return result;
+    }
+
+    Instruction *instruction = board->cur_instruction;
+    instruction->id = INSTRUCTION_IMPORT;
+    instruction->chunk_num_x = CHUNK_NUM_ANY;
+    instruction->chunk_num_y = CHUNK_NUM_ANY;
+    board_send_instruction(board);
+
+    board_reset_history(board);
+    return true;
+}
+
+unsigned long long
+board_get_skipped_count(Board *board)
+{
+    unsigned long long result = 0;
+    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
+        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
+            result += board->segments[j][i]->status->skipped_count;
+        }
+    }
+    return result;
+}
+
+//the huge pages of every kind are summed over the mappings of the arena in /proc/self/smaps
+//(mbind of the affinity splits it into several ones)
+bool
+board_get_pages(Board *board, Board_pages *pages, size_t *arena_size, size_t *huge_size)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        return false;
+    }
+
+    *pages = board->arena_pages;
+    *arena_size = board->arena_size;
+    *huge_size = 0;
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL) {
+        return true;
+    }
+
+    static const char *huge_fields[] = {"AnonHugePages:", "ShmemPmdMapped:", "Shared_Hugetlb:", "Private_Hugetlb:"};
+    uintptr_t arena_start = (uintptr_t) board->arena;
+    uintptr_t arena_end = arena_start + board->arena_size;
+    bool in_arena = false;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps) != NULL) {
+        unsigned long start;
+        unsigned long end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            in_arena = start < arena_end && end > arena_start;
+            continue;
+        }
+        for (unsigned i = 0; in_arena && i < sizeof(huge_fields) / sizeof(*huge_fields); i++) {
+            size_t length = strlen(huge_fields[i]);
+            if (strncmp(line, huge_fields[i], length) == 0) {
+                *huge_size += strtoul(line + length, NULL, 10) * 1024;
+            }
+        }
+    }
+    fclose(smaps);
+    return true;
+}
+
+bool
+board_get_worker_turns(
+    Board *board,
+    unsigned worker_num,
+    unsigned long long *chunk_turns,
+    unsigned long long *stolen_turns)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE || worker_num >= board->workers_count) {
+        return false;
+    }
+
+    Worker_status *status = board->workers_statuses[worker_num];
+    *chunk_turns = status->chunk_turns;
+    *stolen_turns = status->stolen_turns;
+    return true;
+}
+
+bool
+board_get_worker_times(Board *board, unsigned worker_num, unsigned long long *busy_ns, unsigned long long *wait_ns)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE || worker_num >= board->workers_count) {
         return false;
     }
+
+    Worker_status *status = board->workers_statuses[worker_num];
+    *busy_ns = status->busy_ns;
+    *wait_ns = status->wait_ns;
+    return true;
+}
+
+unsigned
+board_get_period(Board *board)
+{
+    return board->period;
+}
+
+//the binary format: the magic, the width and the height (4 bytes each), the generation
+//(8 bytes), all of them are little-endian, then the rows of the bits: cell x of the row
+//is the bit (x - 1) % 8 of the byte (x - 1) / 8, every row starts from the new byte
+static const char binary_magic[] = "LIFEBIN\n";
+
+enum
+{
+    BINARY_MAGIC_SIZE = sizeof(binary_magic) - 1,
+
+    RLE_LINE_LENGTH = 70 //lines of the saved RLE patterns are not longer
+};
+
+static bool
+read_little_endian(FILE *input, unsigned bytes, unsigned long long *value)
+{
+    *value = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+        int byte = getc(input);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (unsigned long long) byte << (8 * i);
+    }
+    return true;
+}
+
+static void
+write_little_endian(FILE *output, unsigned bytes, unsigned long long value)
+{
+    for (unsigned i = 0; i < bytes; i++) {
+        putc((value >> (8 * i)) & 0xFF, output);
+    }
+}
+
+//the loaders fill the bit-packed cells, which are imported at once
+
+static bool
+board_load_text(Board *board, FILE *input, unsigned char *cells, unsigned long long *generation)
+{
     unsigned str_len = board->width + 2;
     char *cur_scanline = calloc(str_len, sizeof(char));
-    for (unsigned i = 1; i <= board->height; i++) {
-        if (fgets(cur_scanline, str_len, input) == NULL ||
+    bool result = true;
+    for (unsigned i = 1; i <= board->height && result; i++) {
+        result = fgets(cur_scanline, str_len, input) != NULL &&
             (cur_scanline[board->width] = '\0',
-            !board_set_scanline(board, i, cur_scanline))) {
-            board_clear(board);
-            free(cur_scanline);
+            board_pack_scanline(board, cells, i, cur_scanline));
+    }
+    free(cur_scanline);
+
+    *generation = 1;
+    return result;
+}
+
+static bool
+board_load_binary(Board *board, FILE *input, unsigned char *cells, unsigned long long *generation)
+{
+    char magic[BINARY_MAGIC_SIZE];
+    unsigned long long width;
+    unsigned long long height;
+    if (fread(magic, 1, BINARY_MAGIC_SIZE, input) != BINARY_MAGIC_SIZE ||
+        memcmp(magic, binary_magic, BINARY_MAGIC_SIZE) != 0 ||
+        !read_little_endian(input, 4, &width) ||
+        !read_little_endian(input, 4, &height) ||
+        !read_little_endian(input, 8, generation)) {
+        return false;
+    }
+    if (width != board->width || height != board->height || *generation == 0) {
+        return false;
+    }
+
+    //the rows are stored the same way, as they're exported
+    size_t size = board->row_size * board->height;
+    if (fread(cells, 1, size, input) != size) {
+        return false;
+    }
+
+    //the bits after the end of the rows are ignored
+    if (board->width % 8 != 0) {
+        for (unsigned j = 0; j < board->height; j++) {
+            cells[(j + 1) * board->row_size - 1] &= (1 << (board->width % 8)) - 1;
+        }
+    }
+    return true;
+}
+
+//only the rule of the board is accepted (B3/S23 in any notation)
+static bool
+rle_rule_supported(char *header)
+{
+    char *rule = strstr(header, "rule");
+    if (rule == NULL) {
+        return true;
+    }
+    rule = strchr(rule, '=');
+    if (rule == NULL) {
+        return false;
+    }
+    do {
+        rule++;
+    } while (*rule == ' ' || *rule == '\t');
+
+    char normalized[8];
+    unsigned length = 0;
+    while (length < sizeof(normalized) - 1 && rule[length] != '\0' && !isspace((unsigned char) rule[length])) {
+        normalized[length] = toupper((unsigned char) rule[length]);
+        length++;
+    }
+    normalized[length] = '\0';
+    return strcmp(normalized, "B3/S23") == 0 || strcmp(normalized, "23/3") == 0;
+}
+
+//the pattern is placed to the top left corner, the rest of the board is empty
+static bool
+board_load_rle(Board *board, FILE *input, unsigned char *cells, unsigned long long *generation)
+{
+    //the generation is kept in the comment by board_save_rle
+    *generation = 1;
+    char header[BUFSIZ];
+    do {
+        if (fgets(header, sizeof(header), input) == NULL) {
             return false;
         }
+        sscanf(header, "#C generation %llu", generation);
+    } while (header[0] == '#');
+
+    unsigned width;
+    unsigned height;
+    if (sscanf(header, " x = %u , y = %u", &width, &height) != 2 ||
+        width > board->width || height > board->height || !rle_rule_supported(header) ||
+        *generation == 0) {
+        return false;
     }
 
-    free(cur_scanline);
+    //the pattern is placed to the top left corner, the rest of the board is empty
+    unsigned long long row = 0;
+    unsigned long long col = 0;
+    unsigned long long count = 0;
+    bool result = true;
+    bool finished = false;
+    int symbol;
+    while (result && !finished && (symbol = getc(input)) != EOF) {
+        if (isdigit(symbol)) {
+            count = count * 10 + (symbol - '0');
+            result = count <= (unsigned long long) board->width + board->height;
+            continue;
+        }
+        if (isspace(symbol)) {
+            continue;
+        }
 
-    board->generation_num = 1;
-    return true;
+        unsigned long long run = count == 0 ? 1 : count;
+        count = 0;
+        if (symbol == '$' || symbol == '!') {
+            row += run;
+            col = 0;
+            finished = symbol == '!';
+        } else if (symbol == 'b' || symbol == '.') {
+            col += run;
+        } else if (isalpha(symbol)) {
+            //the other states of the multistate patterns are alive too
+            result = row < board->height && col + run <= board->width;
+            unsigned char *cur_row = cells + row * board->row_size;
+            for (unsigned long long i = col; i < col + run && result; i++) {
+                cur_row[i / 8] |= 1 << (i % 8);
+            }
+            col += run;
+        } else {
+            result = false;
+        }
+    }
+    return result;
 }
 
 bool
-board_save_to_file(Board *board, FILE *output)
+board_load_from_file(Board *board, FILE *input)
 {
-    if (output == NULL) {
+    if (input == NULL) {
         return false;
     }
 
+    //the text boards start from the cells, the binary ones from the magic,
+    //the RLE patterns from the comments or the header
+    int first = getc(input);
+    ungetc(first, input);
+
+    unsigned char *cells = calloc(board->row_size * board->height, sizeof(*cells));
+    unsigned long long generation;
+    bool result;
+    if (first == binary_magic[0]) {
+        result = board_load_binary(board, input, cells, &generation);
+    } else if (first == '.' || first == '*') {
+        result = board_load_text(board, input, cells, &generation);
+    } else {
+        result = board_load_rle(board, input, cells, &generation);
+    }
+
+    result = result && board_import(board, cells);
+    if (result) {
+        board->generation_num = generation;
+    }
+    free(cells);
+    return result;
+}
+
+static void
+board_save_text(Board *board, FILE *output, unsigned char *cells)
+{
     char *cur_scanline;
     for (unsigned i = 1; i <= board->height; i++) {
-        cur_scanline = board_get_scanline(board, i);
+        cur_scanline = board_unpack_scanline(board, cells, i);
         fprintf(output, "%s\n", cur_scanline);
         free(cur_scanline);
     }
+}
 
-    fflush(output);
-    return true;
+static void
+board_save_binary(Board *board, FILE *output, unsigned char *cells)
+{
+    fwrite(binary_magic, 1, BINARY_MAGIC_SIZE, output);
+    write_little_endian(output, 4, board->width);
+    write_little_endian(output, 4, board->height);
+    write_little_endian(output, 8, board->generation_num);
+    fwrite(cells, 1, board->row_size * board->height, output);
 }
 
+//writes the run of the tags, wrapping the lines
 static void
-board_chunks_destroy(Board *board)
+rle_put(FILE *output, unsigned *line_length, unsigned long long run, char tag)
+{
+    char item[32];
+    int length = run == 1 ?
+        snprintf(item, sizeof(item), "%c", tag) :
+        snprintf(item, sizeof(item), "%llu%c", run, tag);
+    if (*line_length + length > RLE_LINE_LENGTH) {
+        putc('\n', output);
+        *line_length = 0;
+    }
+    fputs(item, output);
+    *line_length += length;
+}
+
+static inline bool
+cells_get(unsigned char *row, unsigned x)
+{
+    return (row[x / 8] >> (x % 8)) & 1;
+}
+
+static void
+board_save_rle(Board *board, FILE *output, unsigned char *cells)
+{
+    fprintf(output, "#C generation %llu\n", board->generation_num);
+    fprintf(output, "x = %u, y = %u, rule = B3/S23\n", board->width, board->height);
+
+    unsigned line_length = 0;
+    unsigned last_row = 0; //the empty rows are written before the next alive one
+    for (unsigned j = 0; j < board->height; j++) {
+        unsigned char *row = cells + (size_t) j * board->row_size;
+
+        //the dead cells at the end of the row are not written
+        unsigned end = board->width;
+        while (end > 0 && !cells_get(row, end - 1)) {
+            end--;
+        }
+        if (end == 0) {
+            continue;
+        }
+
+        if (j > last_row) {
+            rle_put(output, &line_length, j - last_row, '$');
+        }
+        last_row = j;
+
+        unsigned i = 0;
+        while (i < end) {
+            unsigned run_end = i;
+            while (run_end < end && cells_get(row, run_end) == cells_get(row, i)) {
+                run_end++;
+            }
+            rle_put(output, &line_length, run_end - i, cells_get(row, i) ? 'o' : 'b');
+            i = run_end;
+        }
+    }
+    rle_put(output, &line_length, 1, '!');
+    putc('\n', output);
+}
+
+bool
+board_save_to_file(Board *board, FILE *output, Board_file_format format)
+{
+    if (output == NULL) {
+        return false;
+    }
+
+    unsigned char *cells = board_export(board);
+    switch (format) {
+        case BOARD_FORMAT_TEXT:
+            board_save_text(board, output, cells);
+            break;
+        case BOARD_FORMAT_BINARY:
+            board_save_binary(board, output, cells);
+            break;
+        case BOARD_FORMAT_RLE:
+            board_save_rle(board, output, cells);
+            break;
+        default:
+            return false;
+    }
+
+    fflush(output);
+    return !ferror(output);
+}
+
+//sends the instruction with the file to all of the chunks, returns false, if any of them failed
+static bool
+board_file_instruction(Board *board, Instruction_code id, const char *path)
 {
     Instruction *instruction = board->cur_instruction;
-    instruction->id = INSTRUCTION_DESTROY;
+    if (strlen(path) >= sizeof(instruction->path)) {
+        return false;
+    }
+
+    strcpy(instruction->path, path);
+    instruction->id = id;
     instruction->chunk_num_x = CHUNK_NUM_ANY;
     instruction->chunk_num_y = CHUNK_NUM_ANY;
     board_send_instruction(board);
 
+    bool result = true;
     for (unsigned j = 0; j < board->chunks_ver_count; j++) {
         for (unsigned i = 0; i < board->chunks_hor_count; i++) {
-            waitpid(board->chunks[j][i], NULL, 0);
+            result = result && !board->segments[j][i]->status->file_failed;
         }
     }
+    return result;
 }
 
-static inline void
-safe_shm_free(int shm_id)
+bool
+board_load_from_path(Board *board, const char *path)
 {
-    if (shm_id != -1) {
-        shmctl(shm_id, IPC_RMID, NULL);
+    FILE *input = fopen(path, "r");
+    if (input == NULL) {
+        return false;
+    }
+
+    //the text file with the rows of the right length is read by the workers,
+    //anything else is read here
+    int first = getc(input);
+    ungetc(first, input);
+    struct stat file_stat;
+    off_t size = text_file_offset(board, 0, board->height);
+    bool parallel = board->backend != BOARD_BACKEND_HASHLIFE &&
+        (first == '.' || first == '*') &&
+        fstat(fileno(input), &file_stat) == 0 &&
+        (file_stat.st_size == size || file_stat.st_size == size - 1);
+    if (!parallel) {
+        bool result = board_load_from_file(board, input);
+        fclose(input);
+        return result;
+    }
+    fclose(input);
+
+    if (!board_file_instruction(board, INSTRUCTION_LOAD_TEXT, path)) {
+        return false;
     }
+    board_import(board, board->cells);
+    board->generation_num = 1;
+    return true;
 }
 
-void
-board_destroy(Board *board)
+bool
+board_save_to_path(Board *board, const char *path, Board_file_format format)
 {
-    board_chunks_destroy(board);
-
-    shmdt(board->cur_instruction);
+    if (format != BOARD_FORMAT_TEXT || board->backend == BOARD_BACKEND_HASHLIFE) {
+        FILE *output = fopen(path, "w");
+        if (output == NULL) {
+            return false;
+        }
+        bool result = board_save_to_file(board, output, format);
+        return fclose(output) == 0 && result;
+    }
 
-    shmctl(board->shm_id, IPC_RMID, NULL);
-    semctl(board->sem_id, 0, 0, NULL);
+    //the file is created here with its final size, the workers only fill it
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        return false;
+    }
+    bool result = ftruncate(fd, text_file_offset(board, 0, board->height)) == 0;
+    close(fd);
 
-    Border_ids *cur_ids;
-    for (unsigned j = 0; j < board->chunks_ver_count; j++) {
-        for (unsigned i = 0; i < board->chunks_hor_count; i++) {
-            shmdt(board->special_pointers[j][i]);
+    return result && board_file_instruction(board, INSTRUCTION_SAVE_TEXT, path);
+}
 
-            cur_ids = board->border_ids[j][i];
-            safe_shm_free(cur_ids->top);
-            safe_shm_free(cur_ids->left);
-            safe_shm_free(cur_ids->right);
-            safe_shm_free(cur_ids->bottom);
+static void
+board_workers_destroy(Board *board)
+{
+    Instruction *instruction = board->cur_instruction;
+    instruction->id = INSTRUCTION_DESTROY;
+    instruction->chunk_num_x = CHUNK_NUM_ANY;
+    instruction->chunk_num_y = CHUNK_NUM_ANY;
+    board_send_instruction(board);
 
-            if (border_ids_has_special(cur_ids)) {
-                shmctl(cur_ids->special, IPC_RMID, NULL);
-            }
-            free(cur_ids);
+    for (unsigned k = 0; k < board->workers_count; k++) {
+        if (board->backend == BOARD_BACKEND_THREADS) {
+            pthread_join(board->threads[k], NULL);
+        } else {
+            waitpid(board->workers[k], NULL, 0);
         }
-        free(board->special_pointers[j]);
-        free(board->border_ids[j]);
-        free(board->chunks[j]);
     }
-    free(board->special_pointers);
-    free(board->border_ids);
-    free(board->chunks);
+}
+
+void
+board_destroy(Board *board)
+{
+    if (board->backend == BOARD_BACKEND_HASHLIFE) {
+        hashlife_destroy(board->hashlife);
+        free(board->cells);
+        free(board);
+        return;
+    }
 
+    board_chunks_destroy(board);
+    free(board->cpus);
+    free(board->col_starts);
+    free(board->row_starts);
     free(board);
 }
@@ -2,8 +2,13 @@
 #define BOARD_H_INCLUDED
 
 #include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <sys/types.h>
 
+#include "core.h"
+#include "barrier.h"
+
 typedef enum Instruction_code
 {
     INSTRUCTION_NOP,
@@ -17,12 +22,28 @@ typedef enum Instruction_code
     INSTRUCTION_UPDATE_INNER_BORDERS,
     INSTRUCTION_UPDATE_OUTER_BORDERS,
     INSTRUCTION_CALCULATE,
-    INSTRUCTION_CLEAR
+    INSTRUCTION_STEP, //all of the three above in one instruction
+    INSTRUCTION_RUN, //param1 steps, synchronized only with the neighbour chunks by Chunk_status.progress
+    INSTRUCTION_CLEAR,
+    INSTRUCTION_EXPORT, //all of the chunks copy the current frame to Board.cells
+    INSTRUCTION_IMPORT, //and back
+    INSTRUCTION_SAVE_TEXT, //all of the chunks write their cells to the text file at once
+    INSTRUCTION_LOAD_TEXT, //and read them from it to Board.cells
+    INSTRUCTION_UNDO, //param1 generations back by the history of the chunks
+    INSTRUCTION_REDO, //param1 undone generations again
+    INSTRUCTION_CLEAR_HISTORY //the generations are skipped, so the history of the chunks is dropped
 } Instruction_code;
 
 enum
 {
-    CHUNK_NUM_ANY = 0xFFFFFFFF
+    CHUNK_NUM_ANY = 0xFFFFFFFF,
+
+    //the longest period of the oscillations, which the board can detect
+    BOARD_MAX_PERIOD = 64,
+    BOARD_HISTORY_LENGTH = BOARD_MAX_PERIOD + 1,
+
+    //the chunks of the worker are numbered in its deque by 15 bits
+    BOARD_MAX_CHUNKS_PER_WORKER = 0x7FFF
 };
 
 typedef struct Instruction
@@ -32,26 +53,196 @@ typedef struct Instruction
     unsigned chunk_num_y;
     unsigned param1;
     unsigned param2;
+    char path[FILENAME_MAX]; //file of INSTRUCTION_SAVE_TEXT and INSTRUCTION_LOAD_TEXT
 } Instruction;
 
-typedef struct Border_ids
+//state of the chunk, which is seen by the neighbours and the master
+typedef struct Chunk_status
+{
+    //changed[k]: the frame number k differs from the previous generation
+    //(indexed by the frame, so the next one can be written, while the neighbours read the current one)
+    bool changed[2];
+
+    unsigned long long skipped_count; //generations, when the calculation was skipped
+    bool file_failed; //the last instruction with the file failed in this chunk
+
+    //the hash of the frame after the turn t of the worker (or after the changes,
+    //made since it) and whether the turn changed the frame are in the element
+    //t % BOARD_HISTORY_LENGTH, the master compares them to detect the oscillations
+    uint64_t hashes[BOARD_HISTORY_LENGTH];
+    bool turn_changed[BOARD_HISTORY_LENGTH];
+
+    //turns (or blocks of the deep halo and reads of their borders) of INSTRUCTION_RUN,
+    //which are published: the neighbours wait for it instead of the barrier of all of the workers
+    Progress progress;
+
+    //the pool of the workers calculates the block of the deep halo, instead of skipping it
+    //(its borders are read in one round and its turns can be made by another worker in the next one)
+    bool block_active;
+
+    //the ring of the deltas of the generations in the arena, with the budget of the history:
+    //every turn appends the record of the delta from the previous generation (its size in words,
+    //the delta of frame_delta_write and the size again), the oldest records are dropped
+    //the positions are counted without the wrap, the undone records, which can be redone,
+    //are from history_end to history_redo_end
+    Cell_word *history;
+    unsigned long long history_capacity; //in words
+    unsigned long long history_begin;
+    unsigned long long history_end;
+    unsigned long long history_redo_end;
+    unsigned history_count; //records, which can be undone
+    unsigned history_redo_count;
+} Chunk_status;
+
+//state of the worker, which is seen by the other workers and the master
+typedef struct Worker_status
+{
+    //with several chunks per worker: the chunks of the current round, which aren't taken yet,
+    //the worker takes them from the bottom, the other workers steal them from the top
+    atomic_uint deque;
+
+    unsigned long long chunk_turns; //turns of the chunks, calculated by the worker (not skipped)
+    unsigned long long stolen_turns; //of them, the turns of the chunks of the other workers
+
+    //the time of INSTRUCTION_STEP and INSTRUCTION_RUN, spent by the worker on the chunks,
+    //and the time, when it waited for the neighbours or the pool inside of them
+    unsigned long long busy_ns;
+    unsigned long long wait_ns;
+} Worker_status;
+
+typedef struct Chunk_segments
 {
-    int top;
-    int left;
-    int right;
-    int bottom;
+    //created by the master before the workers: the chunk and its frames are in the arena,
+    //so the neighbours read the outer borders directly from them, and any of the workers
+    //can calculate the chunk
+    Chunk *chunk;
 
     //shared memory for communication with father
-    //it can be top, bottom, or, if field consists of 1 chunk, special area
-    int special;
-} Border_ids;
+    char *special;
+
+    Chunk_status *status;
+} Chunk_segments;
+
+//the way the master and the workers synchronize on every instruction
+typedef enum Board_sync
+{
+    BOARD_SYNC_FUTEX, //sense-reversing barrier on atomics and futex in the shared memory
+    BOARD_SYNC_SEMAPHORES //SysV semaphore set
+} Board_sync;
+
+//the way the chunks are calculated
+typedef enum Board_backend
+{
+    BOARD_BACKEND_PROCESSES, //forked workers of the chunks, frames in the shared memory
+    BOARD_BACKEND_THREADS, //worker threads of the chunks in the same process
+    BOARD_BACKEND_HASHLIFE //quadtree of the whole board in the master, workers count is ignored
+} Board_backend;
+
+//the way the workers are placed on the processors
+typedef enum Board_affinity
+{
+    BOARD_AFFINITY_NONE, //by the scheduler of the kernel
+    BOARD_AFFINITY_CORES, //every worker on its processor in the order of the topology, so the workers
+                          //of the neighbour chunks share the caches, the chunks are on their nodes
+    BOARD_AFFINITY_NODES //the same, but every worker runs on any processor of its node
+} Board_affinity;
+
+//the way the board is split into the chunks
+typedef enum Board_partition
+{
+    BOARD_PARTITION_SQUARES, //squares of the same size, except the last row and column of them
+    BOARD_PARTITION_GRID, //any count: columns and rows of the chunks, sized by the estimated work
+    BOARD_PARTITION_STRIPS //any count up to the height: rows of the chunks of the whole width
+} Board_partition;
+
+//the pages of the arena of the board
+typedef enum Board_pages
+{
+    BOARD_PAGES_NORMAL,
+    BOARD_PAGES_HUGETLB, //the reserved huge pages (MAP_HUGETLB)
+    BOARD_PAGES_TRANSPARENT //the normal ones, advised to be merged to the transparent huge pages
+} Board_pages;
+
+typedef struct Board_options
+{
+    Board_backend backend;
+    Board_partition partition;
+    Board_sync sync;
+    Board_affinity affinity;
+    unsigned hashlife_max_nodes; //size of the node cache of BOARD_BACKEND_HASHLIFE
+
+    //the arena with the frames, the statuses and the instruction is mapped with the reserved
+    //huge pages or, if there are none, advised to the transparent ones (false by default)
+    //with the affinity only the chunks of at least a huge page are bound to the nodes:
+    //every one of them is padded to the huge page, the smaller ones share the pages
+    bool huge_pages;
+
+    //depth of the borders of the chunks: during board_run the neighbours synchronize
+    //once in halo_depth generations (limited by the size of the smallest chunk)
+    unsigned halo_depth;
+
+    //the board is split into chunks_per_worker chunks for every worker (1 by default):
+    //with several ones the workers take the chunks of every generation from their deques
+    //and steal them from each other, so a busy part of the board doesn't wait for one worker
+    //(at most BOARD_MAX_CHUNKS_PER_WORKER, the grid partition fits any count of the chunks)
+    unsigned chunks_per_worker;
+
+    //once in rebalance_interval generations of board_run and board_next_turn (zero disables it,
+    //by default) the board calls board_rebalance, unless the period of the board is detected
+    unsigned rebalance_interval;
+    //the bounds of the chunks are moved, if it reduces the estimated work of the busiest
+    //chunk by more than rebalance_threshold percents (10 by default)
+    unsigned rebalance_threshold;
+
+    //memory of the history of undo and redo in bytes, split between the chunks by their area
+    //(zero disables it, by default), the board is undone as far as every chunk has the deltas
+    //the cells, changed not by the turns, board_rebalance and the periods, skipped by
+    //board_fast_forward, start the history anew
+    size_t history_budget;
+
+    //the board checks for the still lifes and the oscillators up to this period
+    //after every turn or run (at most BOARD_MAX_PERIOD, zero disables the detection,
+    //not supported by BOARD_BACKEND_HASHLIFE)
+    unsigned max_period;
+} Board_options;
+
+typedef enum Board_file_format
+{
+    BOARD_FORMAT_TEXT, //a line of '.' and '*' for every row of the board
+    BOARD_FORMAT_BINARY, //bit-packed rows after the header with the size and the generation
+    BOARD_FORMAT_RLE //run length encoded Life pattern (only B3/S23 rule is supported)
+} Board_file_format;
 
 typedef struct Board
 {
-    pid_t **chunks;
-    Border_ids ***border_ids;
+    Board_backend backend;
+    pid_t *workers; //BOARD_BACKEND_PROCESSES
+    pthread_t *threads; //BOARD_BACKEND_THREADS
+    struct Hashlife *hashlife; //BOARD_BACKEND_HASHLIFE
 
-    char ***special_pointers;
+    Chunk_segments ***segments;
+
+    //the worker k is pinned to cpus[k % cpus_count], the memory of its chunks is on the node of it
+    Board_affinity affinity;
+    struct Cpu_place *cpus;
+    unsigned cpus_count;
+
+    //the worker k has the chunks from k * chunks_per_worker to (k + 1) * chunks_per_worker - 1
+    //in the order of the rows, with several ones the workers synchronize the rounds of
+    //the generations by pool_barrier
+    unsigned workers_count;
+    unsigned chunks_per_worker;
+    Worker_status **workers_statuses;
+    struct Barrier *pool_barrier;
+
+    //one mapping for all of the memory, shared with the workers
+    void *arena;
+    size_t arena_size;
+    size_t arena_used; //by the parts, which are already taken
+    bool huge_pages;
+    Board_pages arena_pages;
+    size_t arena_page_size; //the chunks with the affinity start from their own pages
+    unsigned bound_chunks_count; //of them, the chunks, whose pages are bound to the nodes of the workers
 
     unsigned width;
     unsigned height;
@@ -60,29 +251,105 @@ typedef struct Board
     unsigned chunks_hor_count;
     unsigned chunks_ver_count;
 
-    unsigned chunk_size;
-    unsigned last_width;
-    unsigned last_height;
+    //the chunk (i, j) has the columns from col_starts[i] to col_starts[i + 1] - 1
+    //and the rows from row_starts[j] to row_starts[j + 1] - 1 (from zero)
+    unsigned *col_starts;
+    unsigned *row_starts;
+
+    unsigned halo_depth;
+    unsigned max_halo_depth; //of the options, halo_depth is limited by the smallest chunk
+
+    unsigned rebalance_interval;
+    unsigned rebalance_threshold;
+    unsigned long long balance_turn; //turn of the last check of the balance
+    unsigned long long rebalances_count; //times, when the bounds were moved
 
     unsigned long long generation_num;
+    size_t history_budget;
+
+    //the whole board, bit-packed, for board_export and board_import (shared with the workers)
+    unsigned char *cells;
+    size_t row_size;
+
+    unsigned max_period;
+    unsigned period; //of the current state, zero if it isn't detected
+    unsigned long long turns_count; //turns of the workers, never reset
+    unsigned long long history_start; //turn, after which the cells were changed last time
 
+    Board_sync sync;
+
+    //used with BOARD_SYNC_SEMAPHORES
     int sem_id;
-    int shm_id;
+
+    //used with BOARD_SYNC_FUTEX
+    struct Barrier *barrier;
+    unsigned barrier_sense; //local sense of the master
 
     Instruction *cur_instruction;
 } Board;
 
-Board *board_create(unsigned, unsigned, unsigned);
+void board_options_init(Board_options *); //fills the default options
+//width, height and the count of the workers, NULL for the default options
+Board *board_create(unsigned, unsigned, unsigned, const Board_options *);
 void board_destroy(Board *);
 
 bool board_add_cell(Board *, unsigned, unsigned);
 void board_next_turn(Board *);
+bool board_run(Board *, unsigned long long); //a number of turns with one instruction
+
+//the same, but if the board oscillates, the whole periods aren't calculated
+//(the period of the hashes is confirmed by the cells after one more period)
+bool board_fast_forward(Board *, unsigned long long);
 void board_clear(Board *);
 
+//the generations, which can be undone and redone now
+unsigned board_get_undo_depth(Board *);
+unsigned board_get_redo_depth(Board *);
+
+//a number of the generations back or forward by the history, false if it's shorter
+//(the board isn't changed then, not supported by BOARD_BACKEND_HASHLIFE)
+bool board_undo(Board *, unsigned);
+bool board_redo(Board *, unsigned);
+
+//moves the bounds of the columns and the rows of the chunks by the density of the live cells,
+//if it's worth by rebalance_threshold, the chunks and the workers are created again,
+//the cells are copied to them, the history of the period is reset (false if not moved)
+bool board_rebalance(Board *);
+
 char *board_get_scanline(Board *, unsigned);
 bool board_set_scanline(Board *, unsigned, char *);
 
+//the whole board in one instruction: the cell (x, y) is the bit (x - 1) % 8 of the byte
+//(y - 1) * row_size + (x - 1) / 8, the rows are padded to the whole bytes
+//the exported buffer belongs to the board and is valid until the next export or import
+unsigned char *board_export(Board *);
+bool board_import(Board *, const unsigned char *);
+
+//conversions of the rows of the exported buffers
+char *board_unpack_scanline(Board *, const unsigned char *, unsigned);
+bool board_pack_scanline(Board *, unsigned char *, unsigned, const char *);
+
+unsigned long long board_get_skipped_count(Board *); //chunk-generations, skipped as stable
+unsigned board_get_period(Board *); //1 for the still life, 0 if no period is detected
+
+//the pages of the arena, its size and the bytes of it, which are backed by the huge pages
+//at the moment (seen by the master, false for BOARD_BACKEND_HASHLIFE)
+bool board_get_pages(Board *, Board_pages *, size_t *, size_t *);
+
+//chunk-generations, calculated by the worker, and the stolen ones of them (false for the wrong worker)
+bool board_get_worker_turns(Board *, unsigned, unsigned long long *, unsigned long long *);
+
+//the time of the generations, when the worker calculated the chunks, and when it waited
+//for the other workers inside of them, in nanoseconds (false for the wrong worker)
+bool board_get_worker_times(Board *, unsigned, unsigned long long *, unsigned long long *);
+
+//the format is detected by the beginning of the file, the board isn't changed in case of fail
 bool board_load_from_file(Board *, FILE *);
-bool board_save_to_file(Board *, FILE *);
+bool board_save_to_file(Board *, FILE *, Board_file_format);
+
+//the same with the file name: the text files are written and read by all of the workers
+//in parallel, every worker accesses only its rows and columns
+bool board_load_from_path(Board *, const char *);
+bool board_save_to_path(Board *, const char *, Board_file_format);
 
 #endif //BOARD_H_INCLUDED
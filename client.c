@@ -1,12 +1,48 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/msg.h>
 
 #include "common.h"
+#include "publish.h"
 
-int main(void)
+//prints the board, published by the server started with --publish,
+//without stopping the calculation
+int view(void)
 {
+    Published_frame *published = publish_open(publish_key());
+    if (published == NULL) {
+        fprintf(stderr, "ERROR The board is not published, start the server with --publish.\n");
+        return 1;
+    }
+
+    unsigned width = published->header->width;
+    unsigned height = published->header->height;
+    size_t row_size = published->header->row_size;
+    unsigned char *cells = malloc(height * row_size);
+    unsigned long long generation = publish_read(published, cells);
+
+    printf("Generation: %llu\n", generation);
+    for (unsigned j = 0; j < height; j++) {
+        const unsigned char *row = cells + j * row_size;
+        for (unsigned i = 0; i < width; i++) {
+            putchar((row[i / 8] >> (i % 8)) & 1 ? '*' : '.');
+        }
+        putchar('\n');
+    }
+
+    free(cells);
+    publish_destroy(published);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && strcmp(argv[1], "view") == 0) {
+        return view();
+    }
+
     key_t key_out = ftok("life-server", 'a');
     key_t key_in = ftok("life-server", 'b');
     int msg_out_id = msgget(key_out, IPC_CREAT | 0666);
@@ -1,125 +1,292 @@
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "core.h"
 
-Frame *
-frame_create(
-    unsigned width,
-    unsigned height,
-    Borders *inner_borders,
-    Borders *outer_borders)
+static inline Cell
+cell_get(Cell_word *row, unsigned x)
 {
-    if (!width || !height) {
-        return NULL;
+    return (row[x / CELL_WORD_BITS] >> (x % CELL_WORD_BITS)) & 1;
+}
+
+static inline void
+cell_put(Cell_word *row, unsigned x, Cell value)
+{
+    Cell_word bit = (Cell_word) 1 << (x % CELL_WORD_BITS);
+    if (value) {
+        row[x / CELL_WORD_BITS] |= bit;
+    } else {
+        row[x / CELL_WORD_BITS] &= ~bit;
     }
+}
 
-    Frame *result = calloc(1, sizeof(*result));
+enum
+{
+    CACHE_LINE_SIZE = 64,
+    LINE_WORDS = CACHE_LINE_SIZE / sizeof(Cell_word),
 
-    result->width = width;
-    result->height = height;
+    HUGE_PAGE_SIZE = 2 * 1024 * 1024
+};
 
-    result->full_width = width + 2;
-    result->full_height = height + 2;
+static inline size_t
+round_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
 
-    result->data = calloc(result->full_height, sizeof(*result->data));
-    for (unsigned i = 0; i < result->full_height; i++) {
-        result->data[i] = calloc(result->full_width, sizeof(**result->data));
+//allocates zeroed buffer of the given size in bytes, the size is rounded up
+static void *
+frame_buffer_alloc(size_t *size, bool *mapped)
+{
+    if (*size >= HUGE_PAGE_SIZE) {
+        size_t mapped_size = round_up(*size, HUGE_PAGE_SIZE);
+        void *buffer = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(buffer, mapped_size, MADV_HUGEPAGE);
+#endif
+            *size = mapped_size;
+            *mapped = true;
+            return buffer;
+        }
     }
 
-    result->inner_borders = inner_borders;
-    result->outer_borders = outer_borders;
-
-    frame_update_inner_borders(result);
+    *size = round_up(*size, CACHE_LINE_SIZE);
+    *mapped = false;
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, CACHE_LINE_SIZE, *size) != 0) {
+        return NULL;
+    }
+    memset(buffer, 0, *size);
+    return buffer;
+}
 
-    return result;
+static inline Cell_word *
+frame_tile_row(Frame *frame, unsigned tile_y)
+{
+    return frame->changed_tiles + (size_t) tile_y * frame->tile_map_words;
 }
 
-static inline Cell
-safe_deref(Cell *pointer)
+//marks the tile with the cell in the column x and the row y of the buffer
+static inline void
+frame_mark_cell(Frame *frame, unsigned x, unsigned y)
 {
-    return pointer == NULL ? 0 : *pointer;
+    cell_put(frame_tile_row(frame, y / TILE_ROWS), x / CELL_WORD_BITS, CELL_ALIVE);
 }
 
-void
-frame_update_outer_borders(Frame *frame)
+//part of the hash of the frame, which is given by the word i of the row y of the buffer
+static inline uint64_t
+frame_word_hash(Frame *frame, unsigned y, unsigned i, Cell_word word)
 {
-    Borders *borders = frame->outer_borders;
-    if (borders == NULL) {
-        return;
+    //the rows of the outer borders are calculated too with the deep halo
+    if (y < frame->halo || y >= frame->halo + frame->height) {
+        return 0;
     }
+    word &= frame->inner_mask[i];
+    if (word == 0) {
+        return 0;
+    }
+    uint64_t value = (word ^ ((uint64_t) y << 32 | i) * 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+    return value ^ (value >> 31);
+}
 
-    unsigned frst_row = 0;
-    unsigned frst_col = 0;
-    unsigned last_row = frame->full_height - 1;
-    unsigned last_col = frame->full_width - 1;
+static inline void
+frame_update_hash(Frame *frame, unsigned y, unsigned i, Cell_word old_word, Cell_word new_word)
+{
+    frame->hash += frame_word_hash(frame, y, i, new_word) - frame_word_hash(frame, y, i, old_word);
+}
 
-    frame->data[frst_row][frst_col] = safe_deref(borders->tl_angle);
-    frame->data[frst_row][last_col] = safe_deref(borders->tr_angle);
-    frame->data[last_row][frst_col] = safe_deref(borders->bl_angle);
-    frame->data[last_row][last_col] = safe_deref(borders->br_angle);
+static void
+frame_mark_all(Frame *frame)
+{
+    memset(
+        frame->changed_tiles,
+        0xFF,
+        (size_t) frame->tiles_ver * frame->tile_map_words * sizeof(*frame->changed_tiles));
+}
 
-    if (borders->top_side != NULL) {
-        memcpy(
-            frame->data[frst_row] + 1,
-            borders->top_side,
-            frame->width * sizeof(**frame->data));
+//writes the cell of the outer border, marking the tile, if the cell is changed
+static inline void
+frame_put_border_cell(Frame *frame, unsigned x, unsigned y, Cell value)
+{
+    Cell_word *line = frame_line(frame, y);
+    if (cell_get(line, x) != value) {
+        cell_put(line, x, value);
+        frame_mark_cell(frame, x, y);
     }
+}
 
-    if (borders->bottom_side != NULL) {
-        memcpy(
-            frame->data[last_row] + 1,
-            borders->bottom_side,
-            frame->width * sizeof(**frame->data));
+//marks the tiles in the rows and the columns of the buffer (ends are not included)
+static void
+frame_mark_area(Frame *frame, Cell_word *tiles, unsigned frst_col, unsigned end_col, unsigned frst_row, unsigned end_row)
+{
+    if (frst_col >= end_col || frst_row >= end_row) {
+        return;
     }
-
-    if (borders->left_side != NULL) {
-        for (unsigned i = 1; i <= frame->height; i++) {
-            frame->data[i][frst_col] = borders->left_side[i - 1];
+    for (unsigned tile_y = frst_row / TILE_ROWS; tile_y <= (end_row - 1) / TILE_ROWS; tile_y++) {
+        for (unsigned tile_x = frst_col / CELL_WORD_BITS; tile_x <= (end_col - 1) / CELL_WORD_BITS; tile_x++) {
+            cell_put(tiles + (size_t) tile_y * frame->tile_map_words, tile_x, CELL_ALIVE);
         }
     }
+}
 
-    if (borders->right_side != NULL) {
-        for (unsigned i = 1; i <= frame->height; i++) {
-            frame->data[i][last_col] = borders->right_side[i - 1];
+//the outer borders are calculated only on the sides, where the neighbours are
+static void
+frame_init_calc_masks(Frame *frame)
+{
+    unsigned halo = frame->halo;
+    bool has_left = frame->neighbours[FRAME_LEFT] != NULL;
+    bool has_right = frame->neighbours[FRAME_RIGHT] != NULL;
+    bool has_top = frame->neighbours[FRAME_TOP] != NULL;
+    bool has_bottom = frame->neighbours[FRAME_BOTTOM] != NULL;
+    frame->calc_rows[0] = has_top ? halo - 1 : 0;
+    frame->calc_rows[1] = has_bottom ? halo - 1 : 0;
+
+    memset(frame->calc_masks, 0, (size_t) halo * frame->words_count * sizeof(*frame->calc_masks));
+    for (unsigned depth = 0; depth < halo; depth++) {
+        Cell_word *mask = frame->calc_masks + (size_t) depth * frame->words_count;
+        unsigned frst_col = halo - (has_left ? depth : 0);
+        unsigned last_col = halo + frame->width - 1 + (has_right ? depth : 0);
+        for (unsigned i = frst_col; i <= last_col; i++) {
+            cell_put(mask, i, CELL_ALIVE);
         }
     }
 }
 
-void
-frame_update_inner_borders(Frame *frame)
+//words in the rows of the frame with the outer borders
+static inline unsigned
+frame_words_count(unsigned width, unsigned halo)
 {
-    Borders *borders = frame->inner_borders;
-    if (borders == NULL) {
-        return;
-    }
+    return (width + 2 * halo + CELL_WORD_BITS - 1) / CELL_WORD_BITS;
+}
 
-    if (borders->top_side != NULL) {
-        memcpy(
-            borders->top_side,
-            frame->data[1] + 1,
-            frame->width * sizeof(**frame->data));
-    }
+//one cache line before the first row, the guard word after the row is in the padding
+static inline unsigned
+frame_stride(unsigned width, unsigned halo)
+{
+    return round_up(frame_words_count(width, halo) + 1, LINE_WORDS);
+}
+
+//offsets of the parts of the buffer of the frame in bytes, the frame itself is at the beginning
+typedef struct Frame_layout
+{
+    size_t cells; //with the guard line before the first row
+    size_t calc_masks;
+    size_t changed_tiles;
+    size_t halo_tiles; //only with the deep halo
+    size_t tile_scratch;
+    size_t size;
+} Frame_layout;
+
+static void
+frame_layout(unsigned width, unsigned height, unsigned halo, Frame_layout *layout)
+{
+    unsigned words_count = frame_words_count(width, halo);
+    unsigned tiles_ver = (height + 2 * halo + TILE_ROWS - 1) / TILE_ROWS;
+    unsigned tile_map_words = (words_count + CELL_WORD_BITS - 1) / CELL_WORD_BITS;
+    size_t tile_map_size = round_up((size_t) tiles_ver * tile_map_words * sizeof(Cell_word), CACHE_LINE_SIZE);
+
+    size_t offset = round_up(sizeof(Frame), CACHE_LINE_SIZE);
+    layout->cells = offset;
+    offset += (LINE_WORDS + (size_t) (height + 2 * halo) * frame_stride(width, halo)) * sizeof(Cell_word);
+    layout->calc_masks = offset;
+    offset += round_up((size_t) halo * words_count * sizeof(Cell_word), CACHE_LINE_SIZE);
+    layout->changed_tiles = offset;
+    offset += tile_map_size;
+    layout->halo_tiles = offset;
+    offset += halo > 1 ? tile_map_size : 0;
+    layout->tile_scratch = offset;
+    offset += round_up((size_t) (tile_map_words + words_count) * sizeof(Cell_word), CACHE_LINE_SIZE);
+    layout->size = offset;
+}
 
-    if (borders->bottom_side != NULL) {
-        memcpy(
-            borders->bottom_side,
-            frame->data[frame->height] + 1,
-            frame->width * sizeof(**frame->data));
+size_t
+frame_buffer_size(unsigned width, unsigned height, unsigned halo)
+{
+    Frame_layout layout;
+    frame_layout(width, height, halo, &layout);
+    return layout.size;
+}
+
+Frame *
+frame_create(unsigned width, unsigned height, unsigned halo, void *buffer)
+{
+    if (!width || !height || !halo) {
+        return NULL;
     }
 
-    if (borders->left_side != NULL) {
-        for (unsigned i = 1; i <= frame->height; i++) {
-            borders->left_side[i - 1] = frame->data[i][1];
+    Frame_layout layout;
+    frame_layout(width, height, halo, &layout);
+
+    size_t buffer_size = layout.size;
+    bool buffer_mapped = false;
+    bool buffer_owned = buffer == NULL;
+    if (buffer_owned) {
+        buffer = frame_buffer_alloc(&buffer_size, &buffer_mapped);
+        if (buffer == NULL) {
+            return NULL;
         }
     }
 
-    if (borders->right_side != NULL) {
-        for (unsigned i = 1; i <= frame->height; i++) {
-            borders->right_side[i - 1] = frame->data[i][frame->width];
-        }
+    //the frame is at the beginning of its buffer
+    unsigned char *base = buffer;
+    Frame *result = buffer;
+    result->buffer = buffer;
+    result->buffer_size = buffer_size;
+    result->buffer_mapped = buffer_mapped;
+    result->buffer_owned = buffer_owned;
+
+    result->width = width;
+    result->height = height;
+    result->halo = halo;
+
+    result->full_width = width + 2 * halo;
+    result->full_height = height + 2 * halo;
+
+    result->words_count = frame_words_count(width, halo);
+    result->stride = frame_stride(width, halo);
+
+    result->cells = (Cell_word *) (base + layout.cells) + LINE_WORDS;
+
+    //without the neighbours, until frame_set_neighbours
+    result->calc_masks = (Cell_word *) (base + layout.calc_masks);
+    result->inner_mask = result->calc_masks;
+    frame_init_calc_masks(result);
+
+    result->tiles_hor = result->words_count;
+    result->tiles_ver = (result->full_height + TILE_ROWS - 1) / TILE_ROWS;
+    result->tile_map_words = (result->tiles_hor + CELL_WORD_BITS - 1) / CELL_WORD_BITS;
+    result->changed_tiles = (Cell_word *) (base + layout.changed_tiles);
+    result->tile_scratch = (Cell_word *) (base + layout.tile_scratch);
+    frame_mark_all(result);
+
+    //the deep halo is calculated only partially, so it may differ from the previous
+    //frame without the marks: these tiles are calculated every turn
+    result->halo_tiles = NULL;
+    if (halo > 1) {
+        result->halo_tiles = (Cell_word *) (base + layout.halo_tiles);
+        unsigned full_width = result->full_width;
+        unsigned full_height = result->full_height;
+        frame_mark_area(result, result->halo_tiles, 0, full_width, 0, halo);
+        frame_mark_area(result, result->halo_tiles, 0, full_width, halo + height, full_height);
+        frame_mark_area(result, result->halo_tiles, 0, halo, 0, full_height);
+        frame_mark_area(result, result->halo_tiles, halo + width, full_width, 0, full_height);
+    }
+
+    return result;
+}
+
+void
+frame_set_neighbours(Frame *frame, Frame **neighbours)
+{
+    for (unsigned k = 0; k < FRAME_NEIGHBOURS_COUNT; k++) {
+        frame->neighbours[k] = neighbours[k];
     }
+    frame_init_calc_masks(frame);
 }
 
 bool
@@ -132,84 +299,358 @@ frame_set_cell(Frame *frame, unsigned x, unsigned y, Cell value)
         return false;
     }
 
-    frame->data[y][x] = value;
+    unsigned halo = frame->halo;
+    Cell_word *line = frame_line(frame, y + halo - 1);
+    unsigned word_num = (x + halo - 1) / CELL_WORD_BITS;
+    Cell_word old_word = line[word_num];
+    cell_put(line, x + halo - 1, value);
+    frame_update_hash(frame, y + halo - 1, word_num, old_word, line[word_num]);
+    frame_mark_cell(frame, x + halo - 1, y + halo - 1);
+    return true;
+}
 
-    //update borders
-    Borders *borders = frame->inner_borders;
-    if (borders == NULL) {
-        return true;
+Cell
+frame_get_cell(Frame *frame, unsigned x, unsigned y)
+{
+    if (x < 1 || x > frame->width) {
+        return CELL_EMPTY;
+    }
+    if (y < 1 || y > frame->height) {
+        return CELL_EMPTY;
     }
 
-    if (x == 1 && borders->left_side != NULL) {
-        borders->left_side[y - 1] = value;
+    return cell_get(frame_line(frame, y + frame->halo - 1), x + frame->halo - 1);
+}
+
+//bit-sliced adders: every bit of the word is a separate column
+//(macros, because they are used both for the words and for the vectors of words)
+#define HALF_ADD(a, b, sum, carry) \
+    do { \
+        (sum) = (a) ^ (b); \
+        (carry) = (a) & (b); \
+    } while (0)
+
+#define FULL_ADD(a, b, c, sum, carry) \
+    do { \
+        (sum) = (a) ^ (b); \
+        (carry) = ((a) & (b)) | ((sum) & (c)); \
+        (sum) ^= (c); \
+    } while (0)
+
+typedef void (*Line_kernel)(Cell_word *, Cell_word *, Cell_word *, Cell_word *, Cell_word *, Cell_word *, unsigned);
+
+#define KERNEL_NAME calc_line_scalar
+#define KERNEL_WORDS 1
+#include "line_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+
+#define KERNEL_NAME calc_line_sse2
+#define KERNEL_WORDS 2
+#define KERNEL_TARGET "sse2"
+#define KERNEL_TAIL calc_line_scalar
+#include "line_kernel.h"
+
+#define KERNEL_NAME calc_line_avx2
+#define KERNEL_WORDS 4
+#define KERNEL_TARGET "avx2"
+#define KERNEL_TAIL calc_line_sse2
+#include "line_kernel.h"
+
+#define KERNEL_NAME calc_line_avx512
+#define KERNEL_WORDS 8
+#define KERNEL_TARGET "avx512f"
+#define KERNEL_TAIL calc_line_avx2
+#include "line_kernel.h"
+#endif
+
+typedef enum Kernel_id
+{
+#ifdef KERNELS_X86
+    KERNEL_AVX512,
+    KERNEL_AVX2,
+    KERNEL_SSE2,
+#endif
+    KERNEL_SCALAR,
+
+    KERNELS_COUNT
+} Kernel_id;
+
+static const char *kernel_names[KERNELS_COUNT] = {
+#ifdef KERNELS_X86
+    [KERNEL_AVX512] = "avx512",
+    [KERNEL_AVX2] = "avx2",
+    [KERNEL_SSE2] = "sse2",
+#endif
+    [KERNEL_SCALAR] = "scalar"
+};
+
+static Line_kernel kernels[KERNELS_COUNT] = {
+#ifdef KERNELS_X86
+    [KERNEL_AVX512] = calc_line_avx512,
+    [KERNEL_AVX2] = calc_line_avx2,
+    [KERNEL_SSE2] = calc_line_sse2,
+#endif
+    [KERNEL_SCALAR] = calc_line_scalar
+};
+
+static Kernel_id cur_kernel = KERNELS_COUNT; //not selected yet
+
+static bool
+kernel_supported(Kernel_id kernel)
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+#endif
+    switch (kernel) {
+#ifdef KERNELS_X86
+    case KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+#endif
+    case KERNEL_SCALAR:
+        return true;
+    default:
+        return false;
     }
-    if (x == frame->width && borders->right_side != NULL) {
-        borders->right_side[y - 1] = value;
+}
+
+//copies the outer borders of the source to the frame: the frame must keep the borders
+//of the previous generation, so the next update marks exactly the cells, changed since it
+static void
+frame_copy_halo(Frame *frame, Frame *source)
+{
+    unsigned halo = frame->halo;
+    unsigned bottom_row = halo + frame->height;
+    unsigned words_count = frame->words_count;
+
+    for (unsigned j = 0; j < frame->full_height; j++) {
+        Cell_word *line = frame_line(frame, j);
+        Cell_word *source_line = frame_line(source, j);
+        if (j < halo || j >= bottom_row) {
+            memcpy(line, source_line, words_count * sizeof(*line));
+            continue;
+        }
+
+        //only the words with the left and the right borders
+        unsigned left_end = (halo - 1) / CELL_WORD_BITS;
+        unsigned right_frst = (halo + frame->width) / CELL_WORD_BITS;
+        for (unsigned i = 0; i < words_count; i = i == left_end && right_frst > i + 1 ? right_frst : i + 1) {
+            line[i] = (line[i] & frame->inner_mask[i]) | (source_line[i] & ~frame->inner_mask[i]);
+        }
     }
+}
+
+//active tiles of the tile row: changed tiles and their neighbours
+static void
+frame_active_tiles(Frame *frame, unsigned tile_y, Cell_word *active)
+{
+    unsigned map_words = frame->tile_map_words;
 
-    if (y == 1 && borders->top_side != NULL) {
-        borders->top_side[x - 1] = value;
+    //vertical neighbours
+    for (unsigned k = 0; k < map_words; k++) {
+        Cell_word value = frame_tile_row(frame, tile_y)[k];
+        if (tile_y > 0) {
+            value |= frame_tile_row(frame, tile_y - 1)[k];
+        }
+        if (tile_y + 1 < frame->tiles_ver) {
+            value |= frame_tile_row(frame, tile_y + 1)[k];
+        }
+        active[k] = value;
     }
-    if (y == frame->height && borders->bottom_side != NULL) {
-        borders->bottom_side[x - 1] = value;
+
+    //horizontal neighbours
+    Cell_word prev = 0;
+    for (unsigned k = 0; k < map_words; k++) {
+        Cell_word value = active[k];
+        Cell_word next = k + 1 < map_words ? active[k + 1] : 0;
+        active[k] = value | (value << 1) | (value >> 1) |
+            (prev >> (CELL_WORD_BITS - 1)) | (next << (CELL_WORD_BITS - 1));
+        prev = value;
     }
 
-    return true;
+    if (frame->halo_tiles != NULL) {
+        Cell_word *halo_tiles = frame->halo_tiles + (size_t) tile_y * map_words;
+        for (unsigned k = 0; k < map_words; k++) {
+            active[k] |= halo_tiles[k];
+        }
+    }
 }
 
-static inline Cell
-process_cell(Cell old_value, int neighbours_count)
+static bool
+frame_calc_with(Frame *frame, Frame *prev_frame, Kernel_id kernel, unsigned depth)
 {
-    switch (neighbours_count) {
-    case 3:
-        return true;
-    case 2:
-        return old_value;
-    default:
-        return false;
+    Line_kernel calc_line = kernels[kernel];
+    bool changed = false;
+
+    Cell_word *mask = frame->calc_masks + (size_t) depth * frame->words_count;
+    unsigned calc_frst_row = frame->halo - (depth < frame->calc_rows[0] ? depth : frame->calc_rows[0]);
+    unsigned calc_last_row = frame->halo + frame->height - 1 +
+        (depth < frame->calc_rows[1] ? depth : frame->calc_rows[1]);
+
+    frame_copy_halo(frame, prev_frame);
+    frame->hash = prev_frame->hash;
+
+    Cell_word *active = frame->tile_scratch;
+    Cell_word *changed_words = frame->tile_scratch + frame->tile_map_words;
+
+    for (unsigned tile_y = 0; tile_y < frame->tiles_ver; tile_y++) {
+        Cell_word *changed_tiles = frame_tile_row(frame, tile_y);
+        memset(changed_tiles, 0, frame->tile_map_words * sizeof(*changed_tiles));
+
+        frame_active_tiles(prev_frame, tile_y, active);
+
+        unsigned frst_row = tile_y * TILE_ROWS;
+        unsigned last_row = frst_row + TILE_ROWS - 1;
+        if (frst_row < calc_frst_row) {
+            frst_row = calc_frst_row;
+        }
+        if (last_row > calc_last_row) {
+            last_row = calc_last_row;
+        }
+        if (frst_row > last_row) {
+            continue;
+        }
+
+        //calculate the runs of the active tiles
+        unsigned tile_x = 0;
+        while (tile_x < frame->tiles_hor) {
+            if (!cell_get(active, tile_x)) {
+                tile_x++;
+                continue;
+            }
+
+            unsigned frst_tile = tile_x;
+            while (tile_x < frame->tiles_hor && cell_get(active, tile_x)) {
+                tile_x++;
+            }
+            unsigned words_count = tile_x - frst_tile;
+
+            memset(changed_words + frst_tile, 0, words_count * sizeof(*changed_words));
+            for (unsigned j = frst_row; j <= last_row; j++) {
+                Cell_word *line = frame_line(frame, j);
+                Cell_word *prev_line = frame_line(prev_frame, j);
+                calc_line(
+                    line + frst_tile,
+                    frame_line(prev_frame, j - 1) + frst_tile,
+                    prev_line + frst_tile,
+                    frame_line(prev_frame, j + 1) + frst_tile,
+                    mask + frst_tile,
+                    changed_words + frst_tile,
+                    words_count);
+
+                for (unsigned k = frst_tile; k < tile_x; k++) {
+                    if (line[k] != prev_line[k]) {
+                        frame_update_hash(frame, j, k, prev_line[k], line[k]);
+                    }
+                }
+            }
+
+            for (unsigned k = frst_tile; k < tile_x; k++) {
+                if (changed_words[k] != 0) {
+                    cell_put(changed_tiles, k, CELL_ALIVE);
+                    changed = true;
+                }
+            }
+        }
     }
+
+    return changed;
 }
 
-bool
-frame_calc(Frame *frame, Frame *prev_frame)
+//compares results of the kernel with the scalar one on the random frame
+static bool
+kernel_check(Kernel_id kernel)
 {
-    bool stable = true;
+    enum
+    {
+        CHECK_WIDTH = 1000, //many vectors and a tail in every line
+        CHECK_HEIGHT = 20
+    };
+
+    Frame *source = frame_create(CHECK_WIDTH, CHECK_HEIGHT, 1, NULL);
+    Frame *expected = frame_create(CHECK_WIDTH, CHECK_HEIGHT, 1, NULL);
+    Frame *result = frame_create(CHECK_WIDTH, CHECK_HEIGHT, 1, NULL);
+
+    //random cells everywhere, including outer borders
+    //(the garbage in the output frame must be kept outside of the inner mask)
+    uint32_t seed = 12345;
+    for (unsigned j = 0; j < source->full_height; j++) {
+        for (unsigned i = 0; i < source->words_count; i++) {
+            Cell_word value = 0;
+            for (unsigned k = 0; k < 4; k++) {
+                seed = seed * 1103515245 + 12345;
+                value = (value << 16) | (seed >> 16);
+            }
+            frame_line(source, j)[i] = value;
+            frame_line(expected, j)[i] = frame_line(result, j)[i] = ~value;
+        }
+    }
 
-    Cell *prev_line = prev_frame->data[0];
-    Cell *cur_line = prev_frame->data[1];
-    Cell *next_line, *output_line;
+    bool ok = frame_calc_with(expected, source, KERNEL_SCALAR, 0) ==
+        frame_calc_with(result, source, kernel, 0);
+    for (unsigned j = 0; ok && j < source->full_height; j++) {
+        ok = memcmp(frame_line(expected, j), frame_line(result, j), source->words_count * sizeof(Cell_word)) == 0;
+    }
 
-    int neighbours_count;
-    for (unsigned j = 1; j <= frame->height; j++) {
-        next_line = prev_frame->data[j + 1];
-        output_line = frame->data[j];
+    frame_destroy(source);
+    frame_destroy(expected);
+    frame_destroy(result);
+    return ok;
+}
 
-        for (unsigned i = 1; i <= frame->width; i++) {
-            neighbours_count = -cur_line[i];
-            for (unsigned k = i - 1; k <= i + 1; k++) {
-                neighbours_count += prev_line[k];
-                neighbours_count += cur_line[k];
-                neighbours_count += next_line[k];
-            }
-            output_line[i] = process_cell(cur_line[i], neighbours_count);
+void
+frame_select_kernel(void)
+{
+    if (cur_kernel != KERNELS_COUNT) {
+        return;
+    }
 
-            stable = stable && output_line[i] == cur_line[i];
+    //kernels are sorted from the fastest one, scalar kernel is the last
+    cur_kernel = KERNEL_SCALAR;
+    for (Kernel_id i = 0; i < KERNEL_SCALAR; i++) {
+        if (kernel_supported(i) && kernel_check(i)) {
+            cur_kernel = i;
+            break;
         }
+    }
+}
 
-        prev_line = cur_line;
-        cur_line = next_line;
+const char *
+frame_kernel_name(void)
+{
+    frame_select_kernel();
+    return kernel_names[cur_kernel];
+}
+
+bool
+frame_calc(Frame *frame, Frame *prev_frame)
+{
+    return frame_calc_deep(frame, prev_frame, 0);
+}
+
+bool
+frame_calc_deep(Frame *frame, Frame *prev_frame, unsigned depth)
+{
+    if (depth >= frame->halo) {
+        depth = frame->halo - 1;
     }
 
-    return !stable;
+    frame_select_kernel();
+    return frame_calc_with(frame, prev_frame, cur_kernel, depth);
 }
 
 unsigned
 frame_cells_count(Frame *frame)
 {
     unsigned result = 0;
-    for (unsigned j = 1; j <= frame->height; j++) {
-        for (unsigned i = 1; i <= frame->width; i++) {
-            result += frame->data[j][i];
+    for (unsigned j = frame->halo; j < frame->halo + frame->height; j++) {
+        for (unsigned i = 0; i < frame->words_count; i++) {
+            result += __builtin_popcountll(frame_line(frame, j)[i] & frame->inner_mask[i]);
         }
     }
     return result;
@@ -218,10 +659,13 @@ frame_cells_count(Frame *frame)
 void
 frame_clear(Frame *frame)
 {
-    for (unsigned i = 1; i <= frame->height; i++) {
-        memset(frame->data[i] + 1, 0, frame->width * sizeof(*frame->data[i]));
+    frame_mark_all(frame);
+    for (unsigned j = frame->halo; j < frame->halo + frame->height; j++) {
+        for (unsigned i = 0; i < frame->words_count; i++) {
+            frame_line(frame, j)[i] &= ~frame->inner_mask[i];
+        }
     }
-    frame_update_inner_borders(frame);
+    frame->hash = 0;
 }
 
 char *
@@ -234,8 +678,9 @@ frame_render_line(Frame *frame, unsigned y)
     static char map[2] = {'.', '*'};
 
     char *result = calloc(frame->width + 1, sizeof(*result));
-    for (unsigned i = 1; i <= frame->width; i++) {
-        result[i - 1] = map[frame->data[y][i]];
+    Cell_word *cur_line = frame_line(frame, y + frame->halo - 1);
+    for (unsigned i = 0; i < frame->width; i++) {
+        result[i] = map[cell_get(cur_line, i + frame->halo)];
     }
     return result;
 }
@@ -250,23 +695,262 @@ frame_load_line(Frame *frame, char *line, unsigned y)
         return false;
     }
 
-    for (unsigned i = 1; i <= frame->width; i++) {
-        frame->data[y][i] = line[i - 1] == '*';
+    unsigned row = y + frame->halo - 1;
+    Cell_word *cur_line = frame_line(frame, row);
+    for (unsigned i = 0; i < frame->words_count; i++) {
+        frame->hash -= frame_word_hash(frame, row, i, cur_line[i]);
+    }
+    for (unsigned i = 0; i < frame->width; i++) {
+        unsigned col = i + frame->halo;
+        if (cell_get(cur_line, col) != (line[i] == '*')) {
+            cell_put(cur_line, col, line[i] == '*');
+            frame_mark_cell(frame, col, row);
+        }
+    }
+    for (unsigned i = 0; i < frame->words_count; i++) {
+        frame->hash += frame_word_hash(frame, row, i, cur_line[i]);
     }
-
-    frame_update_inner_borders(frame);
     return true;
 }
 
+//count (at most 64) cells of the row from the column col
+static inline Cell_word
+frame_row_bits(Cell_word *line, unsigned col, unsigned count)
+{
+    unsigned shift = col % CELL_WORD_BITS;
+    Cell_word result = line[col / CELL_WORD_BITS] >> shift;
+    if (shift != 0) {
+        result |= line[col / CELL_WORD_BITS + 1] << (CELL_WORD_BITS - shift);
+    }
+    return count < CELL_WORD_BITS ? result & (((Cell_word) 1 << count) - 1) : result;
+}
+
+//the bytes of the buffer, which are not covered entirely, can be shared with
+//the neighbour frame, so only the own bits are changed, atomically
 void
-frame_destroy(Frame *frame)
+bits_write(unsigned char *bits, size_t pos, unsigned count, Cell_word value)
+{
+    unsigned done = 0;
+    while (done < count) {
+        unsigned shift = (pos + done) % 8;
+        unsigned take = 8 - shift < count - done ? 8 - shift : count - done;
+        unsigned char *byte = bits + (pos + done) / 8;
+        unsigned char part = (value >> done) & ((1u << take) - 1);
+        if (take == 8) {
+            *byte = part;
+        } else {
+            unsigned char mask = ((1u << take) - 1) << shift;
+            __atomic_fetch_and(byte, (unsigned char) ~mask, __ATOMIC_RELAXED);
+            __atomic_fetch_or(byte, (unsigned char) (part << shift), __ATOMIC_RELAXED);
+        }
+        done += take;
+    }
+}
+
+static Cell_word
+bits_read(const unsigned char *bits, size_t pos, unsigned count)
+{
+    Cell_word result = 0;
+    unsigned done = 0;
+    while (done < count) {
+        unsigned shift = (pos + done) % 8;
+        unsigned take = 8 - shift < count - done ? 8 - shift : count - done;
+        Cell_word part = (bits[(pos + done) / 8] >> shift) & ((1u << take) - 1);
+        result |= part << done;
+        done += take;
+    }
+    return result;
+}
+
+void
+frame_export(Frame *frame, unsigned char *bits, size_t row_size, unsigned offset)
+{
+    unsigned halo = frame->halo;
+    for (unsigned j = 0; j < frame->height; j++) {
+        Cell_word *line = frame_line(frame, halo + j);
+        unsigned char *row = bits + j * row_size;
+        for (unsigned i = 0; i < frame->width; i += CELL_WORD_BITS) {
+            unsigned count = frame->width - i < CELL_WORD_BITS ? frame->width - i : CELL_WORD_BITS;
+            bits_write(row, (size_t) offset + i, count, frame_row_bits(line, halo + i, count));
+        }
+    }
+}
+
+//writes the word into the line from the column col, marking the changed tiles
+static inline void
+frame_put_word(Frame *frame, unsigned y, unsigned col, unsigned count, Cell_word value)
+{
+    Cell_word *line = frame_line(frame, y);
+    Cell_word mask = count < CELL_WORD_BITS ? ((Cell_word) 1 << count) - 1 : ~(Cell_word) 0;
+    unsigned shift = col % CELL_WORD_BITS;
+    unsigned word_num = col / CELL_WORD_BITS;
+
+    Cell_word old_word = line[word_num];
+    line[word_num] = (old_word & ~(mask << shift)) | (value << shift);
+    if (line[word_num] != old_word) {
+        frame_update_hash(frame, y, word_num, old_word, line[word_num]);
+        frame_mark_cell(frame, col, y);
+    }
+
+    if (shift != 0 && (mask >> (CELL_WORD_BITS - shift)) != 0) {
+        word_num++;
+        old_word = line[word_num];
+        line[word_num] = (old_word & ~(mask >> (CELL_WORD_BITS - shift))) | (value >> (CELL_WORD_BITS - shift));
+        if (line[word_num] != old_word) {
+            frame_update_hash(frame, y, word_num, old_word, line[word_num]);
+            frame_mark_cell(frame, word_num * CELL_WORD_BITS, y);
+        }
+    }
+}
+
+void
+frame_import(Frame *frame, const unsigned char *bits, size_t row_size, unsigned offset)
+{
+    unsigned halo = frame->halo;
+    for (unsigned j = 0; j < frame->height; j++) {
+        const unsigned char *row = bits + j * row_size;
+        for (unsigned i = 0; i < frame->width; i += CELL_WORD_BITS) {
+            unsigned count = frame->width - i < CELL_WORD_BITS ? frame->width - i : CELL_WORD_BITS;
+            frame_put_word(frame, halo + j, halo + i, count, bits_read(row, (size_t) offset + i, count));
+        }
+    }
+}
+
+//the delta is the xor of the inner cells of the two frames: the inner rows are one sequence
+//of words, the runs of it are a header (the zero words before the run in the high half
+//and the count of the words of the run in the low one) and the nonzero words of the run
+static inline Cell_word
+frame_delta_word(Frame *frame, Frame *other, size_t num)
+{
+    unsigned y = frame->halo + num / frame->words_count;
+    unsigned i = num % frame->words_count;
+    return (frame_line(frame, y)[i] ^ frame_line(other, y)[i]) & frame->inner_mask[i];
+}
+
+size_t
+frame_delta_size(Frame *frame, Frame *other)
+{
+    size_t result = 0;
+    bool in_run = false;
+    size_t words_count = (size_t) frame->height * frame->words_count;
+    for (size_t num = 0; num < words_count; num++) {
+        if (frame_delta_word(frame, other, num) != 0) {
+            result += in_run ? 1 : 2;
+            in_run = true;
+        } else {
+            in_run = false;
+        }
+    }
+    return result;
+}
+
+void
+frame_delta_write(Frame *frame, Frame *other, Cell_word *buffer, size_t capacity, size_t pos)
+{
+    size_t header_pos = 0;
+    Cell_word zeros = 0;
+    Cell_word run_words = 0;
+    size_t words_count = (size_t) frame->height * frame->words_count;
+    for (size_t num = 0; num <= words_count; num++) {
+        Cell_word word = num < words_count ? frame_delta_word(frame, other, num) : 0;
+        if (word != 0) {
+            if (run_words == 0) {
+                header_pos = pos;
+                pos = (pos + 1) % capacity;
+            }
+            buffer[pos] = word;
+            pos = (pos + 1) % capacity;
+            run_words++;
+        } else {
+            if (run_words != 0) {
+                buffer[header_pos] = zeros << 32 | run_words;
+                zeros = 0;
+                run_words = 0;
+            }
+            zeros++;
+        }
+    }
+}
+
+void
+frame_delta_apply(Frame *frame, const Cell_word *buffer, size_t capacity, size_t pos, size_t size)
+{
+    size_t num = 0;
+    for (size_t k = 0; k < size; ) {
+        Cell_word header = buffer[(pos + k++) % capacity];
+        num += header >> 32;
+        for (Cell_word run_words = header & 0xFFFFFFFF; run_words > 0; run_words--, num++) {
+            unsigned y = frame->halo + num / frame->words_count;
+            unsigned i = num % frame->words_count;
+            Cell_word *line = frame_line(frame, y);
+            Cell_word old_word = line[i];
+            line[i] ^= buffer[(pos + k++) % capacity];
+            frame_update_hash(frame, y, i, old_word, line[i]);
+            frame_mark_cell(frame, i * CELL_WORD_BITS, y);
+        }
+    }
+}
+
+//shifts of the neighbour chunks in the order of Frame_side
+static const int neighbour_shifts[FRAME_NEIGHBOURS_COUNT][2] = {
+    {-1, -1}, {0, -1}, {+1, -1},
+    {-1,  0},          {+1,  0},
+    {-1, +1}, {0, +1}, {+1, +1}
+};
+
+//copies count cells of the row src_y of the source from the column src_col
+//to the row y of the frame from the column col (the rows are in the buffers)
+static void
+frame_copy_cells(Frame *frame, unsigned y, unsigned col, Frame *source, unsigned src_y, unsigned src_col, unsigned count)
+{
+    Cell_word *src_line = frame_line(source, src_y);
+    for (unsigned i = 0; i < count; i += CELL_WORD_BITS) {
+        unsigned part = count - i < CELL_WORD_BITS ? count - i : CELL_WORD_BITS;
+        frame_put_word(frame, y, col + i, part, frame_row_bits(src_line, src_col + i, part));
+    }
+}
+
+//the halo of the side is the last (first) halo rows and columns of the inner cells
+//of the neighbour, the columns of the left and the right sides are copied
+//by the words of the rows, not cell by cell
+void
+frame_update_outer_borders(Frame *frame)
 {
-    for (unsigned i = 0; i < frame->full_height; i++) {
-        free(frame->data[i]);
+    unsigned halo = frame->halo;
+    for (unsigned k = 0; k < FRAME_NEIGHBOURS_COUNT; k++) {
+        Frame *neighbour = frame->neighbours[k];
+        if (neighbour == NULL) {
+            continue;
+        }
+        int shift_x = neighbour_shifts[k][0];
+        int shift_y = neighbour_shifts[k][1];
+
+        unsigned frst_row = shift_y < 0 ? 0 : shift_y == 0 ? halo : halo + frame->height;
+        unsigned src_frst_row = shift_y < 0 ? neighbour->height : halo;
+        unsigned rows_count = shift_y == 0 ? frame->height : halo;
+
+        unsigned frst_col = shift_x < 0 ? 0 : shift_x == 0 ? halo : halo + frame->width;
+        unsigned src_frst_col = shift_x < 0 ? neighbour->width : halo;
+        unsigned cols_count = shift_x == 0 ? frame->width : halo;
+
+        for (unsigned j = 0; j < rows_count; j++) {
+            frame_copy_cells(frame, frst_row + j, frst_col, neighbour, src_frst_row + j, src_frst_col, cols_count);
+        }
     }
-    free(frame->data);
+}
 
-    free(frame);
+void
+frame_destroy(Frame *frame)
+{
+    //the frame is in its buffer
+    if (!frame->buffer_owned) {
+        return;
+    }
+    if (frame->buffer_mapped) {
+        munmap(frame->buffer, frame->buffer_size);
+    } else {
+        free(frame->buffer);
+    }
 }
 
 
@@ -277,16 +961,28 @@ chunk_update_cur_frame(Chunk *chunk)
     chunk->cur_frame = chunk->frames[chunk->cur_frame_num];
 }
 
+size_t
+chunk_buffer_size(unsigned n)
+{
+    return round_up(sizeof(Chunk), sizeof(Frame *)) + n * sizeof(Frame *);
+}
+
 Chunk *
-chunk_create(unsigned n, ...)
+chunk_create(void *buffer, unsigned n, ...)
 {
     if (n < 2) {
         return NULL;
     }
 
-    Chunk *result = calloc(1, sizeof(*result));
-    result->frames = calloc(n, sizeof(*result->frames));
+    //the array of the frames follows the chunk
+    bool buffer_owned = buffer == NULL;
+    if (buffer_owned) {
+        buffer = calloc(1, chunk_buffer_size(n));
+    }
+    Chunk *result = buffer;
+    result->frames = (Frame **) ((char *) buffer + round_up(sizeof(Chunk), sizeof(Frame *)));
     result->frames_count = n;
+    result->buffer_owned = buffer_owned;
 
     Frame *cur_frame;
 
@@ -300,8 +996,9 @@ chunk_create(unsigned n, ...)
             result->height = cur_frame->height;
         } else {
             if (result->width != cur_frame->width || result->height != cur_frame->height) {
-                free(result->frames);
-                free(result);
+                if (buffer_owned) {
+                    free(result);
+                }
                 return NULL;
             }
         }
@@ -337,12 +1034,19 @@ chunk_do_turn(Chunk *chunk)
 
     frame_update_outer_borders(prev_frame);
     result = frame_calc(cur_frame, prev_frame);
-    frame_update_inner_borders(cur_frame);
 
     chunk_update_cur_frame(chunk);
     return result;
 }
 
+bool
+chunk_do_deep_turn(Chunk *chunk, unsigned depth)
+{
+    Frame *prev_frame = chunk->cur_frame;
+    Frame *cur_frame = chunk_switch_next_frame(chunk);
+    return frame_calc_deep(cur_frame, prev_frame, depth);
+}
+
 bool
 chunk_undo_turn(Chunk *chunk)
 {
@@ -358,9 +1062,28 @@ chunk_undo_turn(Chunk *chunk)
     chunk->undo_depth--;
 
     chunk_update_cur_frame(chunk);
+
+    //the changes of the frame were relative to the older generation
+    frame_mark_all(chunk->cur_frame);
     return true;
 }
 
+void
+chunk_skip_turn(Chunk *chunk)
+{
+    Frame *prev_frame = chunk->cur_frame;
+    chunk_switch_next_frame(chunk);
+
+    //the next frame is the previous generation, which is equal to the current one
+    Frame *frame = chunk->cur_frame;
+    frame_copy_halo(frame, prev_frame);
+    frame->hash = prev_frame->hash;
+    memset(
+        frame->changed_tiles,
+        0,
+        (size_t) frame->tiles_ver * frame->tile_map_words * sizeof(*frame->changed_tiles));
+}
+
 void
 chunk_clear(Chunk *chunk)
 {
@@ -373,6 +1096,7 @@ chunk_destroy(Chunk *chunk)
     for (unsigned i = 0; i < chunk->frames_count; i++) {
         frame_destroy(chunk->frames[i]);
     }
-    free(chunk->frames);
-    free(chunk);
+    if (chunk->buffer_owned) {
+        free(chunk);
+    }
 }
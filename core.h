@@ -1,30 +1,41 @@
 #ifndef CORE_H_INCLUDED
 #define CORE_H_INCLUDED
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 typedef bool Cell;
 
+//cells in frames are packed: 64 cells per word, cell with x coordinate
+//is stored in the bit (x % CELL_WORD_BITS) of the word (x / CELL_WORD_BITS)
+typedef uint64_t Cell_word;
+
 enum
 {
     CELL_EMPTY = false,
-    CELL_ALIVE = true
+    CELL_ALIVE = true,
+
+    CELL_WORD_BITS = 64,
+
+    //frame_calc tracks the changes by the tiles of one word and TILE_ROWS rows
+    TILE_ROWS = 32
 };
 
-typedef struct Borders
+//neighbours of the frame, whose inner cells are its outer borders
+typedef enum Frame_side
 {
-    Cell *top_side;
-    Cell *left_side;
-    Cell *right_side;
-    Cell *bottom_side;
-
-    //the following pointers used only for outer border
-    //(because in the inner border sides includes angles)
-    Cell *tl_angle; //top left
-    Cell *tr_angle; //top right
-    Cell *bl_angle; //botton left
-    Cell *br_angle; //bottom right
-} Borders;
+    FRAME_TOP_LEFT,
+    FRAME_TOP,
+    FRAME_TOP_RIGHT,
+    FRAME_LEFT,
+    FRAME_RIGHT,
+    FRAME_BOTTOM_LEFT,
+    FRAME_BOTTOM,
+    FRAME_BOTTOM_RIGHT,
+
+    FRAME_NEIGHBOURS_COUNT
+} Frame_side;
 
 typedef struct Frame
 {
@@ -36,12 +47,61 @@ typedef struct Frame
     unsigned full_width;
     unsigned full_height;
 
-    Cell **data;
-
-    Borders *inner_borders; //doesn't used in calculations in this frame, but must be updated
-    Borders *outer_borders;
+    //depth of the outer borders: the cell (x, y) is stored in the column
+    //x + halo - 1 and the row y + halo - 1
+    //with the deep halo the frame can be calculated a few turns without
+    //the new outer borders, on the region, which shrinks by a cell every turn
+    unsigned halo;
+
+    unsigned words_count; //number of words in a row (with outer borders)
+    unsigned stride; //distance between rows in words, multiple of the cache line
+
+    //all rows are stored in one cache line aligned buffer, use frame_line to access them
+    //each row has zero guard words line[-1] and line[words_count],
+    //so calculations can look at the neighbouring words without checks
+    Cell_word *cells;
+
+    //the frame itself, its cells, masks and maps are in one buffer, so the frame
+    //in the shared memory can be calculated by any of the processes
+    void *buffer;
+    size_t buffer_size; //in bytes
+    bool buffer_mapped; //large buffers are mapped to use huge pages
+    bool buffer_owned; //false for the buffer, given to frame_create
+
+    Cell_word *inner_mask; //bits of the cells without outer borders (the first of calc_masks)
+
+    //calc_masks + depth * words_count: bits of the cells, calculated by frame_calc_deep
+    //(inner ones and depth cells of the outer borders, which are not beyond the board)
+    Cell_word *calc_masks;
+    unsigned calc_rows[2]; //the same for the rows: depth cells above and below, if they exist
+
+    //bitmap of the tiles, which may differ from the previous generation: bit x of
+    //the row y is the tile of the word x and rows from y * TILE_ROWS (with outer borders)
+    //frame_calc calculates only these tiles and their neighbours, the other tiles
+    //in the result frame must already be the same, as in the previous one
+    unsigned tiles_hor;
+    unsigned tiles_ver;
+    unsigned tile_map_words; //words in a row of the bitmap
+    Cell_word *changed_tiles;
+    Cell_word *halo_tiles; //tiles with the deep halo, which are always calculated (or NULL)
+    Cell_word *tile_scratch; //active tiles of the tile row, changed bits of the words
+
+    //sum of the hashes of the words of the inner cells, updated with the cells,
+    //so the equal frames have the equal hashes (zero for the empty frame)
+    uint64_t hash;
+
+    //frames of the neighbour chunks of the same generation (NULL, if there is no neighbour
+    //on the side): frame_update_outer_borders reads the outer borders from their inner cells,
+    //so the buffers must be shared, if the neighbours are calculated by the other processes
+    struct Frame *neighbours[FRAME_NEIGHBOURS_COUNT];
 } Frame;
 
+static inline Cell_word *
+frame_line(Frame *frame, unsigned y)
+{
+    return frame->cells + (size_t) y * frame->stride;
+}
+
 typedef struct Chunk
 {
     Frame **frames;
@@ -54,33 +114,67 @@ typedef struct Chunk
     unsigned height;
 
     unsigned undo_depth;
+
+    bool buffer_owned; //false for the buffer, given to chunk_create
 } Chunk;
 
 //main functions
-Frame *frame_create(unsigned, unsigned, Borders *, Borders *);
+//width, height, halo and the buffer of the frame: zeroed, aligned to the cache line,
+//of frame_buffer_size bytes, it isn't freed with the frame (NULL to allocate the own one)
+Frame *frame_create(unsigned, unsigned, unsigned, void *);
+size_t frame_buffer_size(unsigned, unsigned, unsigned);
+void frame_set_neighbours(Frame *, Frame **); //FRAME_NEIGHBOURS_COUNT frames with the same halo
 void frame_destroy(Frame *); //calls automatically in chunk_destroy
 
-Chunk *chunk_create(unsigned, ...);
+//the buffer of chunk_buffer_size bytes for the given number of the frames (or NULL),
+//the number of the frames and the frames
+Chunk *chunk_create(void *, unsigned, ...);
+size_t chunk_buffer_size(unsigned);
 void chunk_destroy(Chunk *);
 
 Frame *chunk_switch_next_frame(Chunk *);
 
 //low-level functions (unsafe)
-void frame_update_outer_borders(Frame *);
-void frame_update_inner_borders(Frame *);
+void frame_update_outer_borders(Frame *); //copies the cells of the neighbours to the halo
 bool frame_calc(Frame *, Frame *); //(will not update borders)
+bool frame_calc_deep(Frame *, Frame *, unsigned); //also calculates the depth of outer borders
+
+//the fastest kernel, supported by the processor and passed the self-check,
+//is selected at the first call of frame_calc or frame_select_kernel
+void frame_select_kernel(void);
+const char *frame_kernel_name(void);
 
-//high-level functions (will update borders automatically and check parameters for errors)
+//high-level functions (will check parameters for errors)
 //all of this fuctions will return false or NULL in case of fail (unless otherwise specified)
 void frame_clear(Frame *);
 char *frame_render_line(Frame *, unsigned);
 bool frame_load_line(Frame *, char *, unsigned);
 
+//bit-packed rows of the cells: the cell (x, y) is the bit offset + x - 1 of the row y - 1
+//of the buffer, rows are row_size bytes apart, so the frames of the whole board can be
+//placed in one buffer (the bytes, shared with the neighbour frames, are written atomically)
+void frame_export(Frame *, unsigned char *, size_t, unsigned); //row_size and offset
+void frame_import(Frame *, const unsigned char *, size_t, unsigned);
+void bits_write(unsigned char *, size_t, unsigned, Cell_word); //count cells from the bit pos
+
+//the run-length encoded xor of the inner cells of the two frames of the same size, in words
+//of the circular buffer: the word k of the delta is at (pos + k) % capacity
+size_t frame_delta_size(Frame *, Frame *);
+void frame_delta_write(Frame *, Frame *, Cell_word *, size_t, size_t); //buffer, capacity and pos
+void frame_delta_apply(Frame *, const Cell_word *, size_t, size_t, size_t); //xors the delta of the size
+
 bool frame_set_cell(Frame *, unsigned, unsigned, Cell);
+Cell frame_get_cell(Frame *, unsigned, unsigned); //returns CELL_EMPTY for wrong coordinates
 unsigned frame_cells_count(Frame *); //number of cells who are still alive
 
 bool chunk_do_turn(Chunk *); //returns false if field is stable
+
+//turn with the outer borders, which are already in the current frame, calculates
+//depth cells of them too, doesn't update borders, returns false if the turn is stable
+//(with the deep halo the turns of depth halo - 1, halo - 2, ..., 0 can be done in a row)
+bool chunk_do_deep_turn(Chunk *, unsigned);
 bool chunk_undo_turn(Chunk *);
+void chunk_skip_turn(Chunk *); //turn of the chunk, which is known to be stable
 void chunk_clear(Chunk *);
 
 //all functions will not work correctly with unitialized Frame * or Chunk * pointers
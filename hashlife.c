@@ -0,0 +1,667 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashlife.h"
+
+enum
+{
+    NW = 0,
+    NE = 1,
+    SW = 2,
+    SE = 3,
+
+    HASHLIFE_INITIAL_NODES = 1 << 14
+};
+
+static inline uint32_t
+hashlife_hash(Hashlife_index nw, Hashlife_index ne, Hashlife_index sw, Hashlife_index se)
+{
+    uint32_t result = nw * 0x9E3779B1u;
+    result = (result ^ ne) * 0x85EBCA77u;
+    result = (result ^ sw) * 0xC2B2AE3Du;
+    result = (result ^ se) * 0x27D4EB2Fu;
+    return result ^ (result >> 15);
+}
+
+static inline Hashlife_index
+hashlife_child(Hashlife *life, Hashlife_index node, unsigned num)
+{
+    return life->nodes[node].children[num];
+}
+
+static void
+hashlife_rehash(Hashlife *life)
+{
+    for (unsigned i = 0; i < life->buckets_count; i++) {
+        life->buckets[i] = HASHLIFE_NONE;
+    }
+    for (Hashlife_index i = HASHLIFE_LEAVES_COUNT; i < life->nodes_used; i++) {
+        Hashlife_node *node = &life->nodes[i];
+        if (node->free) {
+            continue;
+        }
+        uint32_t bucket = hashlife_hash(
+            node->children[NW],
+            node->children[NE],
+            node->children[SW],
+            node->children[SE]) & (life->buckets_count - 1);
+        node->next = life->buckets[bucket];
+        life->buckets[bucket] = i;
+    }
+}
+
+//grows the arena up to max_nodes, returns false, if it's impossible
+static bool
+hashlife_grow(Hashlife *life)
+{
+    if (life->nodes_capacity >= life->max_nodes) {
+        return false;
+    }
+
+    unsigned capacity = life->nodes_capacity * 2;
+    if (capacity > life->max_nodes || capacity < life->nodes_capacity) {
+        capacity = life->max_nodes;
+    }
+    Hashlife_node *nodes = realloc(life->nodes, (size_t) capacity * sizeof(*nodes));
+    if (nodes == NULL) {
+        return false;
+    }
+    life->nodes = nodes;
+    life->nodes_capacity = capacity;
+
+    unsigned buckets_count = life->buckets_count;
+    while (buckets_count < capacity) {
+        buckets_count *= 2;
+    }
+    if (buckets_count != life->buckets_count) {
+        Hashlife_index *buckets = realloc(life->buckets, (size_t) buckets_count * sizeof(*buckets));
+        if (buckets == NULL) {
+            return true; //longer chains, but still works
+        }
+        life->buckets = buckets;
+        life->buckets_count = buckets_count;
+        hashlife_rehash(life);
+    }
+    return true;
+}
+
+//returns the unique node with these children, HASHLIFE_NONE, if any of them is
+//HASHLIFE_NONE or there are no free nodes (so the failures go up through the calculations)
+//the node array can be reallocated, so pointers to the nodes must not be kept across the calls
+static Hashlife_index
+hashlife_node(
+    Hashlife *life,
+    Hashlife_index nw,
+    Hashlife_index ne,
+    Hashlife_index sw,
+    Hashlife_index se)
+{
+    if (nw == HASHLIFE_NONE || ne == HASHLIFE_NONE || sw == HASHLIFE_NONE || se == HASHLIFE_NONE) {
+        return HASHLIFE_NONE;
+    }
+
+    uint32_t hash = hashlife_hash(nw, ne, sw, se);
+    Hashlife_index cur = life->buckets[hash & (life->buckets_count - 1)];
+    while (cur != HASHLIFE_NONE) {
+        Hashlife_node *node = &life->nodes[cur];
+        if (node->children[NW] == nw && node->children[NE] == ne &&
+            node->children[SW] == sw && node->children[SE] == se) {
+            return cur;
+        }
+        cur = node->next;
+    }
+
+    Hashlife_index result;
+    if (life->free_list != HASHLIFE_NONE) {
+        result = life->free_list;
+        life->free_list = life->nodes[result].next;
+    } else if (life->nodes_used < life->nodes_capacity || hashlife_grow(life)) {
+        result = life->nodes_used++;
+    } else {
+        return HASHLIFE_NONE;
+    }
+    life->live_nodes++;
+
+    Hashlife_node *node = &life->nodes[result];
+    node->children[NW] = nw;
+    node->children[NE] = ne;
+    node->children[SW] = sw;
+    node->children[SE] = se;
+    node->result = HASHLIFE_NONE;
+    node->result_step = 0;
+    node->level = life->nodes[nw].level + 1;
+    node->population =
+        life->nodes[nw].population +
+        life->nodes[ne].population +
+        life->nodes[sw].population +
+        life->nodes[se].population;
+    node->marked = false;
+    node->free = false;
+
+    Hashlife_index *bucket = &life->buckets[hash & (life->buckets_count - 1)];
+    node->next = *bucket;
+    *bucket = result;
+    return result;
+}
+
+//node of the level, filled with HASHLIFE_VOID or HASHLIFE_DEAD cells
+static Hashlife_index
+hashlife_uniform(Hashlife *life, Hashlife_index state, unsigned level)
+{
+    Hashlife_index *cached = &life->uniform[state][level];
+    if (*cached == HASHLIFE_NONE) {
+        if (level == 0) {
+            *cached = state;
+        } else {
+            Hashlife_index quarter = hashlife_uniform(life, state, level - 1);
+            *cached = hashlife_node(life, quarter, quarter, quarter, quarter);
+        }
+    }
+    return *cached;
+}
+
+//center of the node: one level lower
+static Hashlife_index
+hashlife_center(Hashlife *life, Hashlife_index node)
+{
+    if (node == HASHLIFE_NONE) {
+        return HASHLIFE_NONE;
+    }
+    return hashlife_node(
+        life,
+        hashlife_child(life, hashlife_child(life, node, NW), SE),
+        hashlife_child(life, hashlife_child(life, node, NE), SW),
+        hashlife_child(life, hashlife_child(life, node, SW), NE),
+        hashlife_child(life, hashlife_child(life, node, SE), NW));
+}
+
+//node of the same level between the west and the east ones
+static Hashlife_index
+hashlife_center_hor(Hashlife *life, Hashlife_index west, Hashlife_index east)
+{
+    return hashlife_node(
+        life,
+        hashlife_child(life, west, NE),
+        hashlife_child(life, east, NW),
+        hashlife_child(life, west, SE),
+        hashlife_child(life, east, SW));
+}
+
+//node of the same level between the north and the south ones
+static Hashlife_index
+hashlife_center_ver(Hashlife *life, Hashlife_index north, Hashlife_index south)
+{
+    return hashlife_node(
+        life,
+        hashlife_child(life, north, SW),
+        hashlife_child(life, north, SE),
+        hashlife_child(life, south, NW),
+        hashlife_child(life, south, NE));
+}
+
+//state of the cell in the node of the level 2
+static inline Hashlife_index
+hashlife_small_cell(Hashlife *life, Hashlife_index node, unsigned x, unsigned y)
+{
+    Hashlife_index quarter = hashlife_child(life, node, (y / 2) * 2 + x / 2);
+    return hashlife_child(life, quarter, (y % 2) * 2 + x % 2);
+}
+
+//center of the node of the level 2 after one generation
+static Hashlife_index
+hashlife_small_result(Hashlife *life, Hashlife_index node)
+{
+    Hashlife_index cells[2][2];
+    for (unsigned y = 1; y <= 2; y++) {
+        for (unsigned x = 1; x <= 2; x++) {
+            Hashlife_index state = hashlife_small_cell(life, node, x, y);
+            if (state != HASHLIFE_VOID) {
+                unsigned neighbours = 0;
+                for (unsigned j = y - 1; j <= y + 1; j++) {
+                    for (unsigned i = x - 1; i <= x + 1; i++) {
+                        if ((i != x || j != y) && hashlife_small_cell(life, node, i, j) == HASHLIFE_ALIVE) {
+                            neighbours++;
+                        }
+                    }
+                }
+                bool alive = neighbours == 3 || (neighbours == 2 && state == HASHLIFE_ALIVE);
+                state = alive ? HASHLIFE_ALIVE : HASHLIFE_DEAD;
+            }
+            cells[y - 1][x - 1] = state;
+        }
+    }
+    return hashlife_node(life, cells[0][0], cells[0][1], cells[1][0], cells[1][1]);
+}
+
+//center of the node after 2^step generations, step must be at most level - 2
+static Hashlife_index
+hashlife_result(Hashlife *life, Hashlife_index node, unsigned step)
+{
+    if (node == HASHLIFE_NONE) {
+        return HASHLIFE_NONE;
+    }
+
+    //void cells stay void, dead cells without alive neighbours stay dead
+    if (life->nodes[node].population == 0) {
+        return hashlife_center(life, node);
+    }
+
+    if (life->nodes[node].result != HASHLIFE_NONE && life->nodes[node].result_step == step) {
+        return life->nodes[node].result;
+    }
+
+    unsigned level = life->nodes[node].level;
+    Hashlife_index result;
+    if (level == 2) {
+        result = hashlife_small_result(life, node);
+    } else {
+        //nine overlapping subnodes of the level - 1
+        Hashlife_index nw = hashlife_child(life, node, NW);
+        Hashlife_index ne = hashlife_child(life, node, NE);
+        Hashlife_index sw = hashlife_child(life, node, SW);
+        Hashlife_index se = hashlife_child(life, node, SE);
+        Hashlife_index parts[3][3] = {
+            {nw, hashlife_center_hor(life, nw, ne), ne},
+            {hashlife_center_ver(life, nw, sw), hashlife_center(life, node), hashlife_center_ver(life, ne, se)},
+            {sw, hashlife_center_hor(life, sw, se), se}
+        };
+
+        //advance them by a half of the step, if the step is full,
+        //or just take the centers, so the whole step is made below
+        bool full_step = step == level - 2;
+        for (unsigned j = 0; j < 3; j++) {
+            for (unsigned i = 0; i < 3; i++) {
+                parts[j][i] = full_step ?
+                    hashlife_result(life, parts[j][i], level - 3) :
+                    hashlife_center(life, parts[j][i]);
+            }
+        }
+
+        unsigned quarter_step = full_step ? level - 3 : step;
+        Hashlife_index quarters[2][2];
+        for (unsigned j = 0; j < 2; j++) {
+            for (unsigned i = 0; i < 2; i++) {
+                quarters[j][i] = hashlife_result(
+                    life,
+                    hashlife_node(life, parts[j][i], parts[j][i + 1], parts[j + 1][i], parts[j + 1][i + 1]),
+                    quarter_step);
+            }
+        }
+        result = hashlife_node(life, quarters[0][0], quarters[0][1], quarters[1][0], quarters[1][1]);
+    }
+
+    if (result != HASHLIFE_NONE) {
+        life->nodes[node].result = result;
+        life->nodes[node].result_step = step;
+    }
+    return result;
+}
+
+static void
+hashlife_mark(Hashlife *life, Hashlife_index node)
+{
+    if (node == HASHLIFE_NONE || life->nodes[node].marked) {
+        return;
+    }
+    life->nodes[node].marked = true;
+    if (life->nodes[node].level > 0) {
+        for (unsigned i = 0; i < 4; i++) {
+            hashlife_mark(life, life->nodes[node].children[i]);
+        }
+    }
+}
+
+//frees the nodes, which are not reachable from the root,
+//the cached results pointing to them are forgotten
+static void
+hashlife_collect(Hashlife *life)
+{
+    for (Hashlife_index i = 0; i < HASHLIFE_LEAVES_COUNT; i++) {
+        life->nodes[i].marked = true;
+    }
+    hashlife_mark(life, life->root);
+    for (unsigned state = 0; state < 2; state++) {
+        for (unsigned level = 0; level <= HASHLIFE_MAX_LEVEL; level++) {
+            hashlife_mark(life, life->uniform[state][level]);
+        }
+    }
+
+    for (Hashlife_index i = HASHLIFE_LEAVES_COUNT; i < life->nodes_used; i++) {
+        Hashlife_node *node = &life->nodes[i];
+        if (node->marked && node->result != HASHLIFE_NONE && !life->nodes[node->result].marked) {
+            node->result = HASHLIFE_NONE;
+        }
+    }
+
+    life->free_list = HASHLIFE_NONE;
+    life->live_nodes = HASHLIFE_LEAVES_COUNT;
+    for (Hashlife_index i = life->nodes_used; i-- > HASHLIFE_LEAVES_COUNT; ) {
+        Hashlife_node *node = &life->nodes[i];
+        if (node->marked) {
+            node->marked = false;
+            life->live_nodes++;
+        } else {
+            node->free = true;
+            node->next = life->free_list;
+            life->free_list = i;
+        }
+    }
+    for (Hashlife_index i = 0; i < HASHLIFE_LEAVES_COUNT; i++) {
+        life->nodes[i].marked = false;
+    }
+
+    hashlife_rehash(life);
+    life->collections_count++;
+}
+
+//collects the garbage, when less than a half of the nodes are free
+static inline void
+hashlife_collect_if_needed(Hashlife *life)
+{
+    if (life->live_nodes > life->max_nodes / 2) {
+        hashlife_collect(life);
+    }
+}
+
+//node with the part of the board, which starts at (x, y) in the universe
+static Hashlife_index
+hashlife_build_board(Hashlife *life, unsigned level, uint64_t x, uint64_t y)
+{
+    uint64_t side = (uint64_t) 1 << level;
+    if (x >= life->width || y >= life->height) {
+        return hashlife_uniform(life, HASHLIFE_VOID, level);
+    }
+    if (x + side <= life->width && y + side <= life->height) {
+        return hashlife_uniform(life, HASHLIFE_DEAD, level);
+    }
+
+    uint64_t half = side / 2;
+    return hashlife_node(
+        life,
+        hashlife_build_board(life, level - 1, x, y),
+        hashlife_build_board(life, level - 1, x + half, y),
+        hashlife_build_board(life, level - 1, x, y + half),
+        hashlife_build_board(life, level - 1, x + half, y + half));
+}
+
+Hashlife *
+hashlife_create(unsigned width, unsigned height, unsigned max_nodes)
+{
+    if (width == 0 || height == 0) {
+        return NULL;
+    }
+    if (max_nodes < HASHLIFE_MIN_NODES) {
+        max_nodes = HASHLIFE_MIN_NODES;
+    }
+    if (max_nodes > HASHLIFE_NONE - 1) {
+        max_nodes = HASHLIFE_NONE - 1;
+    }
+
+    Hashlife *result = calloc(1, sizeof(*result));
+    result->width = width;
+    result->height = height;
+
+    //the universe must be at least 4 x 4 to be calculated
+    result->root_level = 2;
+    while (((uint64_t) 1 << result->root_level) < width ||
+        ((uint64_t) 1 << result->root_level) < height) {
+        result->root_level++;
+    }
+
+    result->max_nodes = max_nodes;
+    result->nodes_capacity = max_nodes < HASHLIFE_INITIAL_NODES ? max_nodes : HASHLIFE_INITIAL_NODES;
+    result->nodes = calloc(result->nodes_capacity, sizeof(*result->nodes));
+    result->buckets_count = 1;
+    while (result->buckets_count < result->nodes_capacity) {
+        result->buckets_count *= 2;
+    }
+    result->buckets = calloc(result->buckets_count, sizeof(*result->buckets));
+    if (result->nodes == NULL || result->buckets == NULL) {
+        hashlife_destroy(result);
+        return NULL;
+    }
+    for (unsigned i = 0; i < result->buckets_count; i++) {
+        result->buckets[i] = HASHLIFE_NONE;
+    }
+    for (unsigned state = 0; state < 2; state++) {
+        for (unsigned level = 0; level <= HASHLIFE_MAX_LEVEL; level++) {
+            result->uniform[state][level] = HASHLIFE_NONE;
+        }
+    }
+
+    for (Hashlife_index i = 0; i < HASHLIFE_LEAVES_COUNT; i++) {
+        Hashlife_node *leaf = &result->nodes[i];
+        for (unsigned j = 0; j < 4; j++) {
+            leaf->children[j] = HASHLIFE_NONE;
+        }
+        leaf->result = HASHLIFE_NONE;
+        leaf->next = HASHLIFE_NONE;
+        leaf->population = i == HASHLIFE_ALIVE;
+    }
+    result->nodes_used = HASHLIFE_LEAVES_COUNT;
+    result->live_nodes = HASHLIFE_LEAVES_COUNT;
+    result->free_list = HASHLIFE_NONE;
+
+    result->root = hashlife_build_board(result, result->root_level, 0, 0);
+    if (result->root == HASHLIFE_NONE) {
+        hashlife_destroy(result);
+        return NULL;
+    }
+    return result;
+}
+
+void
+hashlife_destroy(Hashlife *life)
+{
+    free(life->nodes);
+    free(life->buckets);
+    free(life);
+}
+
+static Hashlife_index
+hashlife_set(Hashlife *life, Hashlife_index node, unsigned x, unsigned y, Hashlife_index state)
+{
+    unsigned level = life->nodes[node].level;
+    if (level == 0) {
+        return state;
+    }
+
+    unsigned half = 1u << (level - 1);
+    unsigned num = (y >= half) * 2 + (x >= half);
+    Hashlife_index children[4];
+    memcpy(children, life->nodes[node].children, sizeof(children));
+    children[num] = hashlife_set(life, children[num], x % half, y % half, state);
+    return hashlife_node(life, children[NW], children[NE], children[SW], children[SE]);
+}
+
+bool
+hashlife_set_cell(Hashlife *life, unsigned x, unsigned y, Cell value)
+{
+    if (x < 1 || x > life->width || y < 1 || y > life->height) {
+        return false;
+    }
+    if (hashlife_get_cell(life, x, y) == value) {
+        return true;
+    }
+
+    Hashlife_index state = value ? HASHLIFE_ALIVE : HASHLIFE_DEAD;
+    hashlife_collect_if_needed(life);
+    Hashlife_index root = hashlife_set(life, life->root, x - 1, y - 1, state);
+    if (root == HASHLIFE_NONE) {
+        hashlife_collect(life);
+        root = hashlife_set(life, life->root, x - 1, y - 1, state);
+        if (root == HASHLIFE_NONE) {
+            return false;
+        }
+    }
+    life->root = root;
+    return true;
+}
+
+Cell
+hashlife_get_cell(Hashlife *life, unsigned x, unsigned y)
+{
+    if (x < 1 || x > life->width || y < 1 || y > life->height) {
+        return CELL_EMPTY;
+    }
+
+    x--;
+    y--;
+    Hashlife_index node = life->root;
+    for (unsigned level = life->root_level; level > 0; level--) {
+        if (life->nodes[node].population == 0) {
+            return CELL_EMPTY;
+        }
+        unsigned half = 1u << (level - 1);
+        node = hashlife_child(life, node, (y >= half) * 2 + (x >= half));
+        x %= half;
+        y %= half;
+    }
+    return node == HASHLIFE_ALIVE ? CELL_ALIVE : CELL_EMPTY;
+}
+
+//renders the row y of the node, which starts at the column x of the universe
+static void
+hashlife_render(Hashlife *life, Hashlife_index node, uint64_t x, unsigned y, char *line)
+{
+    if (x >= life->width) {
+        return;
+    }
+
+    unsigned level = life->nodes[node].level;
+    if (life->nodes[node].population == 0) {
+        uint64_t end = x + ((uint64_t) 1 << level);
+        if (end > life->width) {
+            end = life->width;
+        }
+        memset(line + x, '.', end - x);
+    } else if (level == 0) {
+        line[x] = '*';
+    } else {
+        unsigned half = 1u << (level - 1);
+        unsigned row = y >= half ? 2 : 0;
+        hashlife_render(life, hashlife_child(life, node, row + 0), x, y % half, line);
+        hashlife_render(life, hashlife_child(life, node, row + 1), x + half, y % half, line);
+    }
+}
+
+char *
+hashlife_render_line(Hashlife *life, unsigned y)
+{
+    if (y < 1 || y > life->height) {
+        return NULL;
+    }
+
+    char *result = calloc(life->width + 1, sizeof(*result));
+    hashlife_render(life, life->root, 0, y - 1, result);
+    return result;
+}
+
+bool
+hashlife_load_line(Hashlife *life, char *line, unsigned y)
+{
+    if (y < 1 || y > life->height) {
+        return false;
+    }
+    if (line == NULL || strlen(line) != life->width) {
+        return false;
+    }
+
+    for (unsigned i = 1; i <= life->width; i++) {
+        if (!hashlife_set_cell(life, i, y, line[i - 1] == '*')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+hashlife_clear(Hashlife *life)
+{
+    //nothing of the old board is needed anymore
+    life->root = HASHLIFE_NONE;
+    hashlife_collect(life);
+    life->root = hashlife_build_board(life, life->root_level, 0, 0);
+}
+
+unsigned long long
+hashlife_cells_count(Hashlife *life)
+{
+    return life->nodes[life->root].population;
+}
+
+//node of the next level with the given one in the center
+static Hashlife_index
+hashlife_expand(Hashlife *life, Hashlife_index node)
+{
+    if (node == HASHLIFE_NONE) {
+        return HASHLIFE_NONE;
+    }
+
+    unsigned level = life->nodes[node].level;
+    Hashlife_index border = hashlife_uniform(life, HASHLIFE_VOID, level - 1);
+    Hashlife_index nw = hashlife_child(life, node, NW);
+    Hashlife_index ne = hashlife_child(life, node, NE);
+    Hashlife_index sw = hashlife_child(life, node, SW);
+    Hashlife_index se = hashlife_child(life, node, SE);
+    return hashlife_node(
+        life,
+        hashlife_node(life, border, border, border, nw),
+        hashlife_node(life, border, border, ne, border),
+        hashlife_node(life, border, sw, border, border),
+        hashlife_node(life, se, border, border, border));
+}
+
+//advances the root by 2^step generations
+static bool
+hashlife_jump(Hashlife *life, unsigned step)
+{
+    //the result of the node is its center, so the root is expanded
+    //by the void cells until the step fits into it
+    Hashlife_index node = life->root;
+    unsigned level = life->root_level;
+    do {
+        node = hashlife_expand(life, node);
+        level++;
+    } while (level < step + 2);
+
+    node = hashlife_result(life, node, step);
+    for (level--; level > life->root_level; level--) {
+        node = hashlife_center(life, node);
+    }
+
+    if (node == HASHLIFE_NONE) {
+        return false;
+    }
+    life->root = node;
+    return true;
+}
+
+unsigned long long
+hashlife_run(Hashlife *life, unsigned long long generations)
+{
+    unsigned long long done = 0;
+    unsigned max_step = HASHLIFE_MAX_LEVEL - 2;
+    while (done < generations) {
+        unsigned long long left = generations - done;
+        unsigned step = 0;
+        while (step < max_step && (left >> (step + 1)) != 0) {
+            step++;
+        }
+
+        hashlife_collect_if_needed(life);
+        if (!hashlife_jump(life, step)) {
+            hashlife_collect(life);
+            if (!hashlife_jump(life, step)) {
+                //not enough nodes for such a jump, try the smaller ones
+                if (step == 0) {
+                    break;
+                }
+                max_step = step - 1;
+                continue;
+            }
+        }
+        done += (unsigned long long) 1 << step;
+    }
+    return done;
+}
@@ -0,0 +1,83 @@
+#ifndef HASHLIFE_H_INCLUDED
+#define HASHLIFE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "core.h"
+
+//quadtree of the whole board with memoized results (Hashlife)
+//the board is placed in the top left corner of the universe, all of the cells
+//outside of it are void: they are never alive and always count as empty,
+//so the board behaves exactly like the one with the chunks
+
+typedef uint32_t Hashlife_index;
+
+enum
+{
+    HASHLIFE_NONE = 0xFFFFFFFF,
+
+    //leaves are the first nodes, their indices are the states of the cells
+    HASHLIFE_VOID = 0,
+    HASHLIFE_DEAD = 1,
+    HASHLIFE_ALIVE = 2,
+    HASHLIFE_LEAVES_COUNT = 3,
+
+    HASHLIFE_MAX_LEVEL = 64,
+
+    HASHLIFE_MIN_NODES = 1 << 12,
+    HASHLIFE_DEFAULT_MAX_NODES = 1 << 21
+};
+
+typedef struct Hashlife_node
+{
+    Hashlife_index children[4]; //nw, ne, sw, se
+    Hashlife_index result; //center after 2^result_step generations, or HASHLIFE_NONE
+    Hashlife_index next; //in the hash chain or in the free list
+    uint64_t population; //alive cells
+    uint8_t level; //side is 2^level cells
+    uint8_t result_step;
+    bool marked; //used by the garbage collector
+    bool free;
+} Hashlife_node;
+
+typedef struct Hashlife
+{
+    unsigned width;
+    unsigned height;
+
+    Hashlife_index root;
+    unsigned root_level;
+
+    Hashlife_node *nodes;
+    unsigned nodes_used; //nodes below this index were allocated at least once
+    unsigned nodes_capacity;
+    unsigned max_nodes;
+    unsigned live_nodes; //allocated and not freed yet
+    Hashlife_index free_list;
+
+    Hashlife_index *buckets;
+    unsigned buckets_count; //power of two
+
+    //nodes, filled with the void or dead cells, by the level
+    Hashlife_index uniform[2][HASHLIFE_MAX_LEVEL + 1];
+
+    unsigned long long collections_count;
+} Hashlife;
+
+Hashlife *hashlife_create(unsigned, unsigned, unsigned); //width, height and max nodes
+void hashlife_destroy(Hashlife *);
+
+//all of the functions return false or NULL in case of fail (wrong parameters or no free nodes)
+bool hashlife_set_cell(Hashlife *, unsigned, unsigned, Cell);
+Cell hashlife_get_cell(Hashlife *, unsigned, unsigned); //returns CELL_EMPTY for wrong coordinates
+char *hashlife_render_line(Hashlife *, unsigned);
+bool hashlife_load_line(Hashlife *, char *, unsigned);
+void hashlife_clear(Hashlife *);
+unsigned long long hashlife_cells_count(Hashlife *);
+
+//jumps in power-of-two steps and returns the number of generations done,
+//which is less than requested only if the nodes are over even after the garbage collection
+unsigned long long hashlife_run(Hashlife *, unsigned long long);
+
+#endif //HASHLIFE_H_INCLUDED
@@ -0,0 +1,96 @@
+//template of the line kernel, included by core.c once for every instruction set
+//
+//KERNEL_NAME   - name of the function
+//KERNEL_WORDS  - number of words, processed at once
+//KERNEL_TARGET - instruction set of the function (optional)
+//KERNEL_TAIL   - kernel for the words, which don't fill the whole vector (optional)
+//
+//the kernel calculates the next state of the line middle into output
+//(only the bits of mask are changed) and adds the changed bits to changed
+
+#ifdef KERNEL_TARGET
+__attribute__((target(KERNEL_TARGET)))
+#endif
+static void
+KERNEL_NAME(
+    Cell_word *output,
+    Cell_word *top,
+    Cell_word *middle,
+    Cell_word *bottom,
+    Cell_word *mask,
+    Cell_word *changed,
+    unsigned words_count)
+{
+    typedef Cell_word Vector __attribute__((vector_size(KERNEL_WORDS * sizeof(Cell_word))));
+
+    Vector prev, cur, next;
+    Vector tl, tc, tr;
+    Vector ml, mc, mr;
+    Vector bl, bc, br;
+    Vector cur_mask, value, old_value, cur_changed;
+
+    unsigned i;
+    for (i = 0; i + KERNEL_WORDS <= words_count; i += KERNEL_WORDS) {
+        //neighbour with x - 1 is in the next bit, with x + 1 - in the previous one
+        memcpy(&prev, top + i - 1, sizeof(prev));
+        memcpy(&cur, top + i, sizeof(cur));
+        memcpy(&next, top + i + 1, sizeof(next));
+        tl = (cur << 1) | (prev >> (CELL_WORD_BITS - 1));
+        tc = cur;
+        tr = (cur >> 1) | (next << (CELL_WORD_BITS - 1));
+
+        memcpy(&prev, middle + i - 1, sizeof(prev));
+        memcpy(&cur, middle + i, sizeof(cur));
+        memcpy(&next, middle + i + 1, sizeof(next));
+        ml = (cur << 1) | (prev >> (CELL_WORD_BITS - 1));
+        mc = cur;
+        mr = (cur >> 1) | (next << (CELL_WORD_BITS - 1));
+
+        memcpy(&prev, bottom + i - 1, sizeof(prev));
+        memcpy(&cur, bottom + i, sizeof(cur));
+        memcpy(&next, bottom + i + 1, sizeof(next));
+        bl = (cur << 1) | (prev >> (CELL_WORD_BITS - 1));
+        bc = cur;
+        br = (cur >> 1) | (next << (CELL_WORD_BITS - 1));
+
+        Vector top_sum, top_carry;
+        Vector bottom_sum, bottom_carry;
+        Vector middle_sum, middle_carry;
+        FULL_ADD(tl, tc, tr, top_sum, top_carry);
+        FULL_ADD(bl, bc, br, bottom_sum, bottom_carry);
+        HALF_ADD(ml, mr, middle_sum, middle_carry);
+
+        //neighbours count is bit0 + 2 * (top_carry + bottom_carry + middle_carry + ones_carry)
+        Vector bit0, ones_carry;
+        FULL_ADD(top_sum, bottom_sum, middle_sum, bit0, ones_carry);
+
+        Vector twos_sum, twos_carry;
+        FULL_ADD(top_carry, bottom_carry, middle_carry, twos_sum, twos_carry);
+        Vector bit1 = twos_sum ^ ones_carry;
+        Vector bit2 = twos_carry ^ (twos_sum & ones_carry);
+
+        //alive with 3 neighbours or with 2 neighbours, if was alive
+        //(8 neighbours gives zero in all of the three bits)
+        memcpy(&cur_mask, mask + i, sizeof(cur_mask));
+        value = bit1 & ~bit2 & (bit0 | mc) & cur_mask;
+
+        memcpy(&cur_changed, changed + i, sizeof(cur_changed));
+        cur_changed |= value ^ (mc & cur_mask);
+        memcpy(changed + i, &cur_changed, sizeof(cur_changed));
+
+        memcpy(&old_value, output + i, sizeof(old_value));
+        value |= old_value & ~cur_mask;
+        memcpy(output + i, &value, sizeof(value));
+    }
+
+#ifdef KERNEL_TAIL
+    if (i < words_count) {
+        KERNEL_TAIL(output + i, top + i, middle + i, bottom + i, mask + i, changed + i, words_count - i);
+    }
+#endif
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_WORDS
+#undef KERNEL_TARGET
+#undef KERNEL_TAIL
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/shm.h>
+
+#include "publish.h"
+
+static inline void
+cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+key_t
+publish_key(void)
+{
+    return ftok("life-server", 'c');
+}
+
+static Published_frame *
+publish_attach(int shm_id, bool owner)
+{
+    void *address = shmat(shm_id, NULL, owner ? 0 : SHM_RDONLY);
+    if (address == (void *) -1) {
+        return NULL;
+    }
+
+    Published_frame *frame = calloc(1, sizeof(*frame));
+    frame->shm_id = shm_id;
+    frame->owner = owner;
+    frame->header = address;
+    frame->cells = (unsigned char *) address + PUBLISH_HEADER_SIZE;
+    return frame;
+}
+
+Published_frame *
+publish_create(key_t key, unsigned width, unsigned height, size_t row_size)
+{
+    size_t size = PUBLISH_HEADER_SIZE + (size_t) height * row_size;
+
+    //the segment of the previous server may be left, if it was killed
+    int shm_id = shmget(key, 0, 0);
+    if (shm_id != -1) {
+        shmctl(shm_id, IPC_RMID, NULL);
+    }
+
+    shm_id = shmget(key, size, IPC_CREAT | IPC_EXCL | 0644);
+    if (shm_id == -1) {
+        return NULL;
+    }
+    Published_frame *frame = publish_attach(shm_id, true);
+    if (frame == NULL) {
+        shmctl(shm_id, IPC_RMID, NULL);
+        return NULL;
+    }
+
+    //the segment is zeroed, so the readers see the empty board of generation 0
+    frame->header->width = width;
+    frame->header->height = height;
+    frame->header->row_size = row_size;
+    return frame;
+}
+
+void
+publish_frame(Published_frame *frame, const unsigned char *cells, unsigned long long generation)
+{
+    Published_header *header = frame->header;
+    unsigned sequence = atomic_load_explicit(&header->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&header->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    header->generation = generation;
+    memcpy(frame->cells, cells, (size_t) header->height * header->row_size);
+
+    atomic_store_explicit(&header->sequence, sequence + 2, memory_order_release);
+}
+
+Published_frame *
+publish_open(key_t key)
+{
+    int shm_id = shmget(key, 0, 0);
+    if (shm_id == -1) {
+        return NULL;
+    }
+    return publish_attach(shm_id, false);
+}
+
+unsigned long long
+publish_read(Published_frame *frame, unsigned char *cells)
+{
+    Published_header *header = frame->header;
+    unsigned long long generation;
+    unsigned begin, end;
+    do {
+        begin = atomic_load_explicit(&header->sequence, memory_order_acquire);
+        if (begin & 1) {
+            cpu_relax();
+            continue;
+        }
+
+        generation = header->generation;
+        memcpy(cells, frame->cells, (size_t) header->height * header->row_size);
+
+        atomic_thread_fence(memory_order_acquire);
+        end = atomic_load_explicit(&header->sequence, memory_order_relaxed);
+    } while ((begin & 1) || begin != end);
+    return generation;
+}
+
+void
+publish_destroy(Published_frame *frame)
+{
+    shmdt(frame->header);
+    if (frame->owner) {
+        shmctl(frame->shm_id, IPC_RMID, NULL);
+    }
+    free(frame);
+}
@@ -0,0 +1,55 @@
+#ifndef PUBLISH_H_INCLUDED
+#define PUBLISH_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/ipc.h>
+
+//the latest generation of the board, published by the server in the shared memory,
+//so the client and the visualisers can read it while the calculation continues
+
+enum
+{
+    //the cells start after the header at the cache line boundary
+    PUBLISH_HEADER_SIZE = 64
+};
+
+//the header has the same layout for 32-bit and 64-bit readers
+typedef struct Published_header
+{
+    atomic_uint sequence; //seqlock: odd while the server writes the frame
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_size; //bytes in the row of the cells
+    uint64_t generation;
+} Published_header;
+
+//the cells are bit-packed like in board_export:
+//the cell (x, y) is the bit (x - 1) % 8 of the byte (y - 1) * row_size + (x - 1) / 8
+typedef struct Published_frame
+{
+    int shm_id;
+    bool owner; //created by the server, removed at destroy
+    Published_header *header;
+    unsigned char *cells;
+} Published_frame;
+
+//the key of the segment, created by life-server
+key_t publish_key(void);
+
+//server side
+Published_frame *publish_create(key_t, unsigned width, unsigned height, size_t row_size);
+void publish_frame(Published_frame *, const unsigned char *cells, unsigned long long generation);
+
+//reader side, the frame is attached read-only
+Published_frame *publish_open(key_t);
+
+//copies the consistent frame to the buffer of height * row_size bytes
+//returns the generation of the copied frame
+unsigned long long publish_read(Published_frame *, unsigned char *cells);
+
+void publish_destroy(Published_frame *);
+
+#endif //PUBLISH_H_INCLUDED
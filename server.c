@@ -5,13 +5,22 @@
 #include <stdbool.h>
 #include <sys/msg.h>
 
+#include "core.h"
 #include "board.h"
+#include "publish.h"
 #include "text.h"
 #include "common.h"
 
 enum
 {
-    MAX_ARGUMENTS = 4
+    MAX_ARGUMENTS = 4,
+
+    //width, height and workers count
+    POSITIONAL_ARGUMENTS = 3,
+
+    //generations, calculated without checking for messages
+    RUN_BATCH_SIZE = 64,
+    HASHLIFE_RUN_BATCH_SIZE = 1 << 30 //hashlife jumps over them at once
 };
 
 bool
@@ -59,30 +68,139 @@ is_number(char *string)
     return result;
 }
 
+//options look like --name=value
+bool
+parse_option(char *option, Board_options *options, bool *publish)
+{
+    if (strcmp(option, "--publish") == 0) {
+        *publish = true;
+    } else if (strcmp(option, "--huge-pages") == 0) {
+        options->huge_pages = true;
+    } else if (strcmp(option, "--backend=processes") == 0) {
+        options->backend = BOARD_BACKEND_PROCESSES;
+    } else if (strcmp(option, "--backend=threads") == 0) {
+        options->backend = BOARD_BACKEND_THREADS;
+    } else if (strcmp(option, "--sync=futex") == 0) {
+        options->sync = BOARD_SYNC_FUTEX;
+    } else if (strcmp(option, "--backend=hashlife") == 0) {
+        options->backend = BOARD_BACKEND_HASHLIFE;
+    } else if (strcmp(option, "--sync=semaphores") == 0) {
+        options->sync = BOARD_SYNC_SEMAPHORES;
+    } else if (strcmp(option, "--affinity=none") == 0) {
+        options->affinity = BOARD_AFFINITY_NONE;
+    } else if (strcmp(option, "--affinity=cores") == 0) {
+        options->affinity = BOARD_AFFINITY_CORES;
+    } else if (strcmp(option, "--affinity=nodes") == 0) {
+        options->affinity = BOARD_AFFINITY_NODES;
+    } else if (strcmp(option, "--partition=squares") == 0) {
+        options->partition = BOARD_PARTITION_SQUARES;
+    } else if (strcmp(option, "--partition=grid") == 0) {
+        options->partition = BOARD_PARTITION_GRID;
+    } else if (strcmp(option, "--partition=strips") == 0) {
+        options->partition = BOARD_PARTITION_STRIPS;
+    } else if (strncmp(option, "--hashlife-nodes=", 17) == 0 && is_number(option + 17)) {
+        options->hashlife_max_nodes = atol(option + 17);
+    } else if (strncmp(option, "--chunks-per-worker=", 20) == 0 && is_number(option + 20) &&
+        atol(option + 20) > 0 && atol(option + 20) <= BOARD_MAX_CHUNKS_PER_WORKER) {
+        options->chunks_per_worker = atol(option + 20);
+    } else if (strncmp(option, "--rebalance=", 12) == 0 && is_number(option + 12)) {
+        options->rebalance_interval = atol(option + 12);
+    } else if (strncmp(option, "--rebalance-threshold=", 22) == 0 && is_number(option + 22)) {
+        options->rebalance_threshold = atol(option + 22);
+    } else if (strncmp(option, "--history=", 10) == 0 && is_number(option + 10)) {
+        options->history_budget = (size_t) atol(option + 10) << 20;
+    } else if (strncmp(option, "--halo=", 7) == 0 && is_number(option + 7) && atol(option + 7) > 0) {
+        options->halo_depth = atol(option + 7);
+    } else if (strncmp(option, "--period=", 9) == 0 && is_number(option + 9) &&
+        atol(option + 9) <= BOARD_MAX_PERIOD) {
+        options->max_period = atol(option + 9);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//the format of the saved file: text, binary or rle
+bool
+parse_file_format(char *name, Board_file_format *format)
+{
+    if (strcmp(name, "text") == 0) {
+        *format = BOARD_FORMAT_TEXT;
+    } else if (strcmp(name, "binary") == 0) {
+        *format = BOARD_FORMAT_BINARY;
+    } else if (strcmp(name, "rle") == 0) {
+        *format = BOARD_FORMAT_RLE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//copies the current generation to the shared memory for the readers
+void
+publish_board(Published_frame *published, Board *board)
+{
+    if (published != NULL) {
+        publish_frame(published, board_export(board), board->generation_num);
+    }
+}
+
 int
 main(int argc, char *argv[])
 {
-    if (argc != 4) {
-        fprintf(stderr, "%s\n", argc < 4 ? ERROR_TOO_FEW_ARGS : ERROR_TOO_MUCH_ARGS);
+    Board_options options;
+    board_options_init(&options);
+    bool publish = false;
+
+    char *positional[POSITIONAL_ARGUMENTS];
+    int positional_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            if (!parse_option(argv[i], &options, &publish)) {
+                fprintf(stderr, "%s %s\n", ERROR_OPTION, argv[i]);
+                fprintf(stderr, "%s\n", CORRECT_USE_INFO);
+                return 1;
+            }
+        } else if (positional_count < POSITIONAL_ARGUMENTS) {
+            positional[positional_count++] = argv[i];
+        } else {
+            positional_count++;
+        }
+    }
+
+    if (positional_count != POSITIONAL_ARGUMENTS) {
+        fprintf(stderr, "%s\n", positional_count < POSITIONAL_ARGUMENTS ? ERROR_TOO_FEW_ARGS : ERROR_TOO_MUCH_ARGS);
         fprintf(stderr, "%s\n", CORRECT_USE_INFO);
         return 1;
     }
 
-    long width = atol(argv[1]);
-    long height = atol(argv[2]);
-    long chunks_count = atol(argv[3]);
+    long width = atol(positional[0]);
+    long height = atol(positional[1]);
+    long workers_count = atol(positional[2]);
 
     if (width < 1 || height < 1) {
         fprintf(stderr, "%s\n", ERROR_DIMENSIONS);
         return 2;
     }
 
-    Board *board = board_create(width, height, chunks_count);
+    Board *board = board_create(width, height, workers_count, &options);
     if (board == NULL) {
         fprintf(stderr, "%s\n", ERROR_WORKERS_COUNT);
         return 3;
     }
 
+    printf("%s %s\n", LOG_KERNEL, frame_kernel_name());
+
+    Published_frame *published = NULL;
+    if (publish) {
+        published = publish_create(publish_key(), board->width, board->height, board->row_size);
+        if (published == NULL) {
+            fprintf(stderr, "%s\n", ERROR_PUBLISH);
+            board_destroy(board);
+            return 4;
+        }
+    }
+
     key_t key_in = ftok("life-server", 'a');
     key_t key_out = ftok("life-server", 'b');
     int msg_in_id = msgget(key_in, IPC_CREAT | 0666);
@@ -96,16 +214,20 @@ main(int argc, char *argv[])
     int args_count;
 
     unsigned long long end_generation = 0;
+    unsigned long long run_batch_size = options.backend == BOARD_BACKEND_HASHLIFE ?
+        HASHLIFE_RUN_BATCH_SIZE :
+        RUN_BATCH_SIZE;
 
     //answer, sended to client
     char *answer;
 
     //temporary variables, used in snapshot
     unsigned block_size;
+    unsigned char *exported_cells;
     char *cur_scanline;
 
-    //temporary variable, used in loading from / saving to file
-    FILE *file;
+    //temporary variable, used in saving to file
+    Board_file_format file_format;
 
     bool terminate = false;
     do {
@@ -119,7 +241,31 @@ main(int argc, char *argv[])
             msgrcv(msg_in_id, &message, MSG_SIZE, 0, IPC_NOWAIT);
             if (message.mtype == -1) {
                 //no messages recieved
-                board_next_turn(board);
+                unsigned long long generations = end_generation - board->generation_num;
+                if (board_get_period(board) != 0) {
+                    //the board will never change, the endless calculation is stopped,
+                    //the others skip the whole periods
+                    printf(LOG_PERIOD_FORMAT, board_get_period(board), board->generation_num);
+                    if (end_generation == (unsigned long long) -1) {
+                        end_generation = 0;
+                        continue;
+                    }
+                    if (!board_fast_forward(board, generations)) {
+                        printf("%s\n", LOG_RUN_FAILED);
+                    }
+                    publish_board(published, board);
+                    end_generation = 0;
+                    continue;
+                }
+
+                if (generations > run_batch_size) {
+                    generations = run_batch_size;
+                }
+                if (!board_run(board, generations)) {
+                    printf("%s\n", LOG_RUN_FAILED);
+                    end_generation = 0;
+                }
+                publish_board(published, board);
                 if (board->generation_num == end_generation) {
                     end_generation = 0;
                 }
@@ -141,12 +287,14 @@ main(int argc, char *argv[])
                 if(!board_add_cell(board, atoi(args[1]), atoi(args[2]))) {
                     answer = (char *) ERROR_COORDINATES;
                 }
+                publish_board(published, board);
             }
         } else if (strcmp(args[0], "clear") == 0) {
             if (args_count > 1) {
                 answer = (char *) ERROR_TOO_MUCH_ARGS;
             } else {
                 board_clear(board);
+                publish_board(published, board);
             }
         } else if (strcmp(args[0], "start") == 0) {
             if (args_count > 2) {
@@ -174,13 +322,29 @@ main(int argc, char *argv[])
             } else {
                 end_generation = 0;
             }
+        } else if (strcmp(args[0], "undo") == 0 || strcmp(args[0], "redo") == 0) {
+            if (args_count > 2) {
+                answer = (char *) ERROR_TOO_MUCH_ARGS;
+            } else if (args_count == 2 && !is_number(args[1])) {
+                answer = (char *) ERROR_NUMERIC_ARG;
+            } else {
+                unsigned generations = args_count == 2 ? atoi(args[1]) : 1;
+                bool done = strcmp(args[0], "undo") == 0 ?
+                    board_undo(board, generations) :
+                    board_redo(board, generations);
+                if (!done) {
+                    answer = (char *) ERROR_HISTORY;
+                }
+                publish_board(published, board);
+            }
         } else if (strcmp(args[0], "snapshot") == 0) {
             if (args_count > 1) {
                 answer = (char *) ERROR_TOO_MUCH_ARGS;
             } else {
                 message.mtype = MSG_CONTINUE;
+                exported_cells = board_export(board);
                 for (int j = 1; j <= board->height; j++) {
-                    cur_scanline = board_get_scanline(board, j);
+                    cur_scanline = board_unpack_scanline(board, exported_cells, j);
                     for (int i = 0; i < board->width; i += BUF_SIZE) {
                         block_size = board->width - i;
                         if (block_size > BUF_SIZE) {
@@ -206,28 +370,86 @@ main(int argc, char *argv[])
             } else if (args_count > 2) {
                 answer = (char *) ERROR_TOO_MUCH_ARGS;
             } else {
-                file = fopen(args[1], "r");
-                if (file == NULL) {
+                if (access(args[1], R_OK) != 0) {
                     answer = (char *) ERROR_FILE_OPEN;
-                } else {
-                    if (!board_load_from_file(board, file)) {
-                        answer = (char *) ERROR_FILE_FORMAT;
-                    }
-                    fclose(file);
+                } else if (!board_load_from_path(board, args[1])) {
+                    answer = (char *) ERROR_FILE_FORMAT;
                 }
+                publish_board(published, board);
             }
         } else if (strcmp(args[0], "save") == 0) {
             if (args_count < 2) {
                 answer = (char *) ERROR_TOO_FEW_ARGS;
-            } else if (args_count > 2) {
+            } else if (args_count > 3) {
                 answer = (char *) ERROR_TOO_MUCH_ARGS;
+            } else if (args_count == 3 && !parse_file_format(args[2], &file_format)) {
+                answer = (char *) ERROR_SAVE_FORMAT;
             } else {
-                file = fopen(args[1], "w");
-                if (file == NULL) {
+                if (args_count == 2) {
+                    file_format = BOARD_FORMAT_TEXT;
+                }
+                if (!board_save_to_path(board, args[1], file_format)) {
                     answer = (char *) ERROR_FILE_CREATE;
-                } else {
-                    board_save_to_file(board, file);
-                    fclose(file);
+                }
+            }
+        } else if (strcmp(args[0], "stats") == 0) {
+            if (args_count > 1) {
+                answer = (char *) ERROR_TOO_MUCH_ARGS;
+            } else {
+                message.mtype = MSG_CONTINUE;
+                snprintf(
+                    message.mtext,
+                    sizeof(message.mtext),
+                    STATS_FORMAT,
+                    board->generation_num,
+                    board_get_skipped_count(board),
+                    board_get_period(board));
+                msgsnd(msg_out_id, &message, MSG_SIZE, 0);
+
+                //the balance of the workers, which steal the chunks from each other
+                unsigned long long chunk_turns;
+                unsigned long long stolen_turns;
+                for (unsigned k = 0; board->chunks_per_worker > 1 &&
+                    board_get_worker_turns(board, k, &chunk_turns, &stolen_turns); k++) {
+                    snprintf(message.mtext, sizeof(message.mtext), STATS_WORKER_FORMAT, k, chunk_turns, stolen_turns);
+                    msgsnd(msg_out_id, &message, MSG_SIZE, 0);
+                }
+                //whether the huge pages are really given by the kernel
+                Board_pages pages;
+                size_t arena_size;
+                size_t huge_size;
+                if (board_get_pages(board, &pages, &arena_size, &huge_size)) {
+                    snprintf(
+                        message.mtext,
+                        sizeof(message.mtext),
+                        STATS_PAGES_FORMAT,
+                        arena_size / 1024,
+                        PAGES_NAMES[pages],
+                        huge_size / 1024);
+                    msgsnd(msg_out_id, &message, MSG_SIZE, 0);
+                }
+                //the chunks, which are smaller than the page, or the kernel without the numa aren't bound
+                if (board->affinity != BOARD_AFFINITY_NONE) {
+                    snprintf(
+                        message.mtext,
+                        sizeof(message.mtext),
+                        STATS_AFFINITY_FORMAT,
+                        board->bound_chunks_count,
+                        board->chunks_count);
+                    msgsnd(msg_out_id, &message, MSG_SIZE, 0);
+                }
+                if (board->history_budget != 0) {
+                    snprintf(
+                        message.mtext,
+                        sizeof(message.mtext),
+                        STATS_HISTORY_FORMAT,
+                        board_get_undo_depth(board),
+                        board_get_redo_depth(board));
+                    msgsnd(msg_out_id, &message, MSG_SIZE, 0);
+                }
+                if (board->rebalance_interval != 0) {
+                    snprintf(message.mtext, sizeof(message.mtext), STATS_REBALANCES_FORMAT, board->rebalances_count);
+                    msgsnd(msg_out_id, &message, MSG_SIZE, 0);
                 }
             }
         } else if (strcmp(args[0], "quit") == 0) {
@@ -244,6 +466,9 @@ main(int argc, char *argv[])
     msgctl(key_out, IPC_RMID, NULL);
     msgctl(key_in, IPC_RMID, NULL);
 
+    if (published != NULL) {
+        publish_destroy(published);
+    }
     board_destroy(board);
     return 0;
 }
@@ -4,11 +4,51 @@
 //messages, used only in server
 const char *ERROR_DIMENSIONS = "ERROR Width and height must be positive.";
 const char *ERROR_WORKERS_COUNT = "ERROR The field cannot be divided to this amount of workers.";
-const char *CORRECT_USE_INFO = "Correct use:\n./life-client [width] [height] [workers_count].";
+const char *ERROR_OPTION = "ERROR Unknown option:";
+const char *ERROR_PUBLISH = "ERROR Fail to create the shared memory for the published board.";
+const char *CORRECT_USE_INFO =
+    "Correct use:\n./life-server [options] [width] [height] [workers_count].\n"
+    "Options:\n"
+    "  --backend=processes|threads|hashlife  workers of the chunks or hashlife (processes by default)\n"
+    "  --sync=futex|semaphores               synchronization of the workers (futex by default)\n"
+    "  --affinity=none|cores|nodes           pin every worker to a processor or to the node of it:\n"
+    "                                        the neighbour chunks share the caches and the node,\n"
+    "                                        their memory is on it (none by default)\n"
+    "  --partition=squares|grid|strips       chunks of the board: squares need a fitting count of\n"
+    "                                        the chunks, grid and strips take any count and size\n"
+    "                                        the chunks by their work (squares by default)\n"
+    "  --chunks-per-worker=N                 chunks of every worker, which the other workers\n"
+    "                                        can steal, when they are idle (1 by default)\n"
+    "  --rebalance=N                         move the bounds of the chunks by the density of\n"
+    "                                        the live cells once in N generations (0 by default,\n"
+    "                                        disabled), not with the period of the board detected\n"
+    "  --rebalance-threshold=P               only if the busiest chunk gets more than P percents\n"
+    "                                        less work (10 by default)\n"
+    "  --hashlife-nodes=N                    node cache size of hashlife (2097152 by default)\n"
+    "  --halo=K                              depth of the borders: the chunks synchronize\n"
+    "                                        once in K generations (1 by default)\n"
+    "  --period=N                            longest period of the oscillations, which stop\n"
+    "                                        the calculation (64 by default, 0 disables)\n"
+    "  --history=MB                          memory for the undo and the redo of the generations\n"
+    "                                        (0 by default, disabled)\n"
+    "  --huge-pages                          map the frames of the chunks with the huge pages,\n"
+    "                                        the reserved or the transparent ones\n"
+    "  --publish                             publish the latest generation in the shared memory\n"
+    "                                        for ./life-client view";
 
 const char *LOG_COMMAND_RECIEVED = "Command recieved:";
+const char *LOG_KERNEL = "Calculation kernel:";
+const char *LOG_RUN_FAILED = "Calculation stopped: hashlife node cache is too small.";
+const char *LOG_PERIOD_FORMAT = "Board repeats itself with period %u at generation %llu.\n";
 
 //messages, which will be sended to client
+const char *STATS_FORMAT = "Generation: %llu\nSkipped chunk-generations: %llu\nPeriod: %u\n";
+const char *STATS_WORKER_FORMAT = "Worker %u: %llu chunk-generations, %llu stolen\n";
+const char *STATS_PAGES_FORMAT = "Arena: %zu KiB of %s pages, %zu KiB in huge pages\n";
+const char *PAGES_NAMES[] = {"normal", "reserved huge", "transparent huge"}; //by Board_pages
+const char *STATS_AFFINITY_FORMAT = "Memory of %u of %u chunks is bound to the nodes of the workers\n";
+const char *STATS_HISTORY_FORMAT = "History: %u generations to undo, %u to redo\n";
+const char *STATS_REBALANCES_FORMAT = "Rebalances of the chunks: %llu\n";
 const char *ERROR_NO = "OK";
 const char *ERROR_UNKNOWN = "ERROR Unknown command.";
 const char *ERROR_NOT_SUPPORTED = "ERROR Not supported yet.";
@@ -21,5 +61,7 @@ const char *ERROR_NOT_STARTED = "ERROR Nothing to stop.";
 const char *ERROR_FILE_OPEN = "ERROR File is not exists or access violation.";
 const char *ERROR_FILE_FORMAT = "ERROR Wrong file format.";
 const char *ERROR_FILE_CREATE = "ERROR Fail to create file.";
+const char *ERROR_HISTORY = "ERROR History is too short.";
+const char *ERROR_SAVE_FORMAT = "ERROR Unknown file format, use text, binary or rle.";
 
 #endif //TEXT_H_INCLUDED